@@ -0,0 +1,167 @@
+#include "asteroid_lod.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int default_step_ticks = 4;
+// beyond isolation_rm times the equilibrium distance, the repulsion is below
+// a millionth of its value there
+static const double isolation_rm = 2.0;
+
+static bool asteroid_lod_reserve(asteroid_lod *lod, int length) {
+    if (length <= lod->rows_capacity) {
+        return true;
+    }
+    int *grown = realloc(lod->rows, (size_t)length * sizeof(int));
+    if (grown == NULL) {
+        return false;
+    }
+    lod->rows = grown;
+    lod->rows_capacity = length;
+    return true;
+}
+
+asteroid_lod asteroid_lod_create_default() {
+    asteroid_lod lod = (asteroid_lod){0};
+    lod.radius = 0.0;
+    lod.step_ticks = default_step_ticks;
+    lod.focus = vec_create_zero();
+    return lod;
+}
+
+bool asteroid_lod_parse_arg(asteroid_lod *lod, const char *arg) {
+    if (strncmp(arg, "--sim-lod-radius=", 17) == 0) {
+        double radius = atof(arg + 17);
+        lod->radius = radius < 0.0 ? 0.0 : radius;
+        return true;
+    }
+    if (strncmp(arg, "--sim-lod-step=", 15) == 0) {
+        int step_ticks = atoi(arg + 15);
+        lod->step_ticks = step_ticks < 1 ? default_step_ticks : step_ticks;
+        return true;
+    }
+    return false;
+}
+
+bool asteroid_lod_enabled(const asteroid_lod *lod) {
+    return lod->radius > 0.0 && lod->step_ticks > 1;
+}
+
+int asteroid_lod_build_rows(asteroid_lod *lod, vector *asteroids) {
+    int length = vector_length(asteroids);
+    lod->num_rows = 0;
+    if (!asteroid_lod_reserve(lod, length)) {
+        // without room for the rows, every asteroid steps every tick
+        return -1;
+    }
+    lod->ticks += 1;
+    for (int ia = 0; ia < length; ++ia) {
+        asteroid *ast = (asteroid *)vector_get(asteroids, ia);
+        if (ast->lod_step == 1) {
+            lod->active += 1;
+            lod->rows[lod->num_rows++] = ia;
+            continue;
+        }
+        lod->far += 1;
+        if (ast->lod_countdown != 1) {
+            continue;
+        }
+        if (ast->frozen_steps > 0) {
+            // isolated, coasts along its trajectory
+            ast->frozen_steps -= 1;
+            ast->acc = vec_create_zero();
+            lod->frozen += 1;
+            continue;
+        }
+        lod->rows[lod->num_rows++] = ia;
+    }
+    lod->rows_computed += (unsigned long)lod->num_rows;
+    return lod->num_rows;
+}
+
+void asteroid_lod_after_row(const asteroid_lod *lod, asteroid *ast,
+                            double nearest, const dyn_params *dp) {
+    ast->frozen_steps = 0;
+    if (ast->lod_step == 1 || dp->grav != 0.0) {
+        return;
+    }
+    // the largest asteroids of the same size are in equilibrium at rm
+    double rm = 2.0 * sqrt(2.0) * dp->asteroid_radius;
+    double gap = nearest - isolation_rm * rm;
+    // an approaching neighbour closes the gap by this much per step at most
+    double closing = 2.0 * dp->asteroid_max_vel * dp->dt * lod->step_ticks;
+    if (gap > 0.0 && closing > 0.0) {
+        ast->frozen_steps = (int)floor(gap / closing) - 1;
+        ast->frozen_steps = ast->frozen_steps < 0 ? 0 : ast->frozen_steps;
+    }
+}
+
+// moves pos_m1 so that pos - pos_m1 covers step_ticks ticks instead of
+// lod_step, at the same velocity
+static void asteroid_lod_rescale(asteroid *ast, int step_ticks) {
+    vec step = vec_sub(ast->pos, ast->pos_m1);
+    vec_scale_inplace(&step, (double)step_ticks / ast->lod_step);
+    ast->pos_m1 = vec_sub(ast->pos, step);
+    ast->lod_step = step_ticks;
+}
+
+void asteroid_lod_update_position(const asteroid_lod *lod, asteroid *ast,
+                                  const dyn_params *dp) {
+    // until its next step, a far asteroid and the vessel can get this much
+    // closer, and the focus is one tick late
+    double margin = (dp->asteroid_max_vel + dp->vessel_max_vel) * dp->dt *
+                    (lod->step_ticks + 1);
+
+    if (ast->lod_step == 1) {
+        asteroid_update_position(ast, dp->dt);
+        asteroid_make_periodic(ast, dp->pos_min.x, dp->pos_max.x,
+                               dp->pos_min.y, dp->pos_max.y);
+        double distance =
+            vec_distance_periodic(ast->pos, lod->focus, dp->pos_min.x,
+                                  dp->pos_max.x, dp->pos_min.y, dp->pos_max.y);
+        // twice the margin, not to come back at the next step
+        if (distance > lod->radius + 2.0 * margin) {
+            asteroid_lod_rescale(ast, lod->step_ticks);
+            ast->lod_countdown = lod->step_ticks;
+            ast->frozen_steps = 0;
+        }
+        return;
+    }
+
+    ast->lod_countdown -= 1;
+    if (ast->lod_countdown > 0) {
+        return;
+    }
+    asteroid_update_position(ast, dp->dt * ast->lod_step);
+    asteroid_make_periodic(ast, dp->pos_min.x, dp->pos_max.x, dp->pos_min.y,
+                           dp->pos_max.y);
+    ast->lod_countdown = ast->lod_step;
+    double distance =
+        vec_distance_periodic(ast->pos, lod->focus, dp->pos_min.x,
+                              dp->pos_max.x, dp->pos_min.y, dp->pos_max.y);
+    if (distance < lod->radius + margin) {
+        asteroid_lod_rescale(ast, 1);
+        ast->lod_countdown = 0;
+        ast->frozen_steps = 0;
+    }
+}
+
+void asteroid_lod_print(const asteroid_lod *lod, FILE *out) {
+    if (!asteroid_lod_enabled(lod) || lod->ticks == 0) {
+        return;
+    }
+    double ticks = (double)lod->ticks;
+    fprintf(out,
+            "simulation level of detail: radius %g, far step %d ticks, per "
+            "tick %.1f active, %.1f far, %.2f frozen, %.1f force rows\n",
+            lod->radius, lod->step_ticks, (double)lod->active / ticks,
+            (double)lod->far / ticks, (double)lod->frozen / ticks,
+            (double)lod->rows_computed / ticks);
+}
+
+void asteroid_lod_free(asteroid_lod *lod) {
+    free(lod->rows);
+    lod->rows = NULL;
+    lod->rows_capacity = 0;
+    lod->num_rows = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef _ASTEROID_LOD_H_
+#define _ASTEROID_LOD_H_
+
+#include "../c_vector/vector.h"
+#include "../geom/dyn_params.h"
+#include "../geom/vec.h"
+#include "asteroids.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Level of detail of the simulation: the asteroids further than radius from
+// the vessel are far, and only step every step_ticks ticks with a step of
+// step_ticks * dt. The forces of a far asteroid are computed for the steps
+// it takes only, and not at all while it is isolated: with no gravity, an
+// asteroid further than the interaction distance from all the others feels
+// no force until one of them can have crossed the gap. The previous position
+// is rescaled when an asteroid changes of step, so that its velocity, and
+// thus its trajectory, is kept.
+typedef struct _asteroid_lod {
+    double radius;  // around the vessel, 0 steps every asteroid every tick
+    int step_ticks; // ticks per step of the far asteroids
+    vec focus;      // position of the vessel, read with mutex_update
+    int *rows;      // asteroids whose forces are needed this tick
+    int num_rows;
+    int rows_capacity;
+    unsigned long ticks;
+    unsigned long active;
+    unsigned long far;
+    unsigned long frozen;
+    unsigned long rows_computed;
+} asteroid_lod;
+
+asteroid_lod asteroid_lod_create_default();
+
+// handles --sim-lod-radius=<r> and --sim-lod-step=<ticks>, returns false if
+// arg is not for the level of detail of the simulation
+bool asteroid_lod_parse_arg(asteroid_lod *lod, const char *arg);
+
+bool asteroid_lod_enabled(const asteroid_lod *lod);
+
+// fills the rows with the asteroids that step this tick and need their
+// forces, returns their number
+int asteroid_lod_build_rows(asteroid_lod *lod, vector *asteroids);
+
+// once the forces of a far asteroid are computed, given the distance to its
+// closest neighbour, counts the next steps it can take without them
+void asteroid_lod_after_row(const asteroid_lod *lod, asteroid *ast,
+                            double nearest, const dyn_params *dp);
+
+// steps the asteroid if due this tick, then moves it to the step of its
+// distance to the vessel
+void asteroid_lod_update_position(const asteroid_lod *lod, asteroid *ast,
+                                  const dyn_params *dp);
+
+void asteroid_lod_print(const asteroid_lod *lod, FILE *out);
+
+void asteroid_lod_free(asteroid_lod *lod);
+
+#endif
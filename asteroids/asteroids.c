@@ -1,6 +1,7 @@
 #include "asteroids.h"
 #include "../c_vector/vector.h"
 #include "../geom/dynamics.h"
+#include "../geom/grid.h"
 #include "../geom/utils.h"
 #include "../vessel/bullet.h"
 #include <assert.h>
@@ -14,10 +15,16 @@ asteroid *asteroid_create(vec pos, vec pos_m1, vec acc, double r, double mass,
     ast->pos = pos;
     ast->pos_m1 = pos_m1;
     ast->acc = acc;
+    ast->acc_far = vec_create_zero();
+    ast->pos_far = pos;
+    ast->far_computed = false;
     ast->r = r;
     ast->mass = mass;
     ast->generation = generation;
     ast->max_velocity = max_velocity;
+    ast->lod_step = 1;
+    ast->lod_countdown = 0;
+    ast->frozen_steps = 0;
     return ast;
 }
 
@@ -33,7 +40,8 @@ vector asteroid_create_two_asteroids_from_parent(const asteroid *const ast,
                                                     double dt) {
     vector v;
     vector_init(&v);
-    double vel_norm = vec_norm(dynamics_compute_vel(ast->pos, ast->pos_m1, dt));
+    double vel_norm = vec_norm(
+        dynamics_compute_vel(ast->pos, ast->pos_m1, dt * ast->lod_step));
     double theta = double_rand_inrange(0, 2 * PI);
     vec vel = vec_create(cos(theta), sin(theta));
 
@@ -50,18 +58,31 @@ vector asteroid_create_two_asteroids_from_parent(const asteroid *const ast,
     return v;
 }
 
-vector asteroid_blow(asteroid **ast, double dt) {
+vec asteroid_prev_pos(const asteroid *const ast) {
+    vec step = vec_sub(ast->pos, ast->pos_m1);
+    return vec_sub(ast->pos, vec_scale(step, 1.0 / ast->lod_step));
+}
+
+vector asteroid_blow(asteroid **ast, double dt, debris *d) {
     vector children;
     if ((*ast)->generation < 2) {
         children = asteroid_create_two_asteroids_from_parent(*ast, dt);
     } else {
         vector_init(&children);
+        if (d != NULL) {
+            const asteroid *a = *ast;
+            debris_spawn(d, a->pos,
+                         dynamics_compute_vel(a->pos, a->pos_m1,
+                                              dt * a->lod_step),
+                         a->r);
+        }
     }
     asteroid_destroy(ast);
     return children;
 }
 
-void asteroid_blown_by_bullets(vector *ast, vector *bullets, double dt) {
+void asteroid_blown_by_bullets(vector *ast, vector *bullets, double dt,
+                               debris *d) {
     for (int i = 0; i < vector_length(bullets); ++i) {
         for (int j = 0; j < vector_length(ast); ++j) {
             if (bullet_is_inside_asteroid(
@@ -72,7 +93,7 @@ void asteroid_blown_by_bullets(vector *ast, vector *bullets, double dt) {
                 i -= 1; // a bit ugly but... we removed an element so we must go
                         // back one i
                 asteroid *a = (asteroid *)vector_remove(ast, j);
-                vector children = asteroid_blow(&a, dt);
+                vector children = asteroid_blow(&a, dt, d);
                 vector_drain_into(&children, ast);
                 vector_free(&children);
                 break; // break at most one asteroid with a bullet
@@ -81,6 +102,170 @@ void asteroid_blown_by_bullets(vector *ast, vector *bullets, double dt) {
     }
 }
 
+static vec asteroid_grid_pos(const void *ctx, int index) {
+    asteroid *const *arr = (asteroid *const *)ctx;
+    return arr[index]->pos;
+}
+
+static int asteroid_grid_max_cells(const grid *g, double max_radius) {
+    int kx = (int)ceil(2.0 * max_radius / (g->x1 - g->x0) * g->nx) + 2;
+    int ky = (int)ceil(2.0 * max_radius / (g->y1 - g->y0) * g->ny) + 2;
+    return (kx < g->nx ? kx : g->nx) * (ky < g->ny ? ky : g->ny);
+}
+
+// smallest index in arr of a (non NULL) asteroid containing p, -1 if none
+static int asteroid_grid_first_hit(const grid *g, asteroid *const *arr,
+                                   double max_radius, vec p, int *cells,
+                                   int max_cells) {
+    int num_cells =
+        grid_cells_in_rect(g, p.x - max_radius, p.x + max_radius,
+                           p.y - max_radius, p.y + max_radius, cells, max_cells);
+    int first = -1;
+    for (int c = 0; c < num_cells; ++c) {
+        for (int k = g->cell_start[cells[c]]; k < g->cell_start[cells[c] + 1];
+             ++k) {
+            int index = g->items[k];
+            if (first >= 0 && index >= first) {
+                break; // items are sorted in a cell
+            }
+            if (arr[index] != NULL && asteroid_is_inside(arr[index], p)) {
+                first = index;
+            }
+        }
+    }
+    return first;
+}
+
+static void asteroid_remove_pointer(vector *ast, const asteroid *a) {
+    for (int j = 0; j < vector_length(ast); ++j) {
+        if (vector_get(ast, j) == a) {
+            vector_remove(ast, j);
+            return;
+        }
+    }
+}
+
+void asteroid_blown_by_bullets_grid(vector *ast, vector *bullets, double dt,
+                                    double max_radius, grid *g, debris *d) {
+    int num_asteroids = vector_length(ast);
+    if (num_asteroids == 0 || vector_length(bullets) == 0) {
+        return;
+    }
+    asteroid **arr = malloc((size_t)num_asteroids * sizeof(asteroid *));
+    for (int j = 0; j < num_asteroids; ++j) {
+        arr[j] = (asteroid *)vector_get(ast, j);
+    }
+    grid_build(g, num_asteroids, asteroid_grid_pos, (const void *)arr);
+    int max_cells = asteroid_grid_max_cells(g, max_radius);
+    int *cells = malloc((size_t)max_cells * sizeof(int));
+    // asteroids born during this call, checked after the others as they come
+    // after them in ast
+    vector children;
+    vector_init(&children);
+
+    for (int i = 0; i < vector_length(bullets); ++i) {
+        bullet *b = (bullet *)vector_get(bullets, i);
+        asteroid *a = NULL;
+        int first =
+            asteroid_grid_first_hit(g, arr, max_radius, b->pos, cells, max_cells);
+        if (first >= 0) {
+            a = arr[first];
+            arr[first] = NULL;
+        } else {
+            for (int j = 0; j < vector_length(&children); ++j) {
+                asteroid *child = (asteroid *)vector_get(&children, j);
+                if (bullet_is_inside_asteroid(b, child)) {
+                    a = (asteroid *)vector_remove(&children, j);
+                    break;
+                }
+            }
+        }
+        if (a == NULL) {
+            continue;
+        }
+
+        b = (bullet *)vector_remove(bullets, i);
+        bullet_destroy(&b);
+        i -= 1;
+        asteroid_remove_pointer(ast, a);
+        vector new_children = asteroid_blow(&a, dt, d);
+        for (int j = 0; j < vector_length(&new_children); ++j) {
+            vector_push(&children, vector_get(&new_children, j));
+        }
+        vector_drain_into(&new_children, ast);
+        vector_free(&new_children);
+    }
+
+    // children only borrows the asteroids owned by ast
+    for (int j = 0; j < vector_length(&children); ++j) {
+        vector_set(&children, j, NULL);
+    }
+    vector_free(&children);
+    free(cells);
+    free(arr);
+}
+
+int asteroid_count_hits_grid(vector ast, const vec *points, int num_points,
+                             double max_radius, grid *g) {
+    int num_asteroids = vector_length(&ast);
+    asteroid **arr = malloc((size_t)(num_asteroids > 0 ? num_asteroids : 1) *
+                            sizeof(asteroid *));
+    for (int j = 0; j < num_asteroids; ++j) {
+        arr[j] = (asteroid *)vector_get(&ast, j);
+    }
+
+    int num_hits = 0;
+    if (g == NULL) {
+        for (int i = 0; i < num_points; ++i) {
+            for (int j = 0; j < num_asteroids; ++j) {
+                if (asteroid_is_inside(arr[j], points[i])) {
+                    num_hits += 1;
+                    break;
+                }
+            }
+        }
+    } else {
+        grid_build(g, num_asteroids, asteroid_grid_pos, (const void *)arr);
+        int max_cells = asteroid_grid_max_cells(g, max_radius);
+        int *cells = malloc((size_t)max_cells * sizeof(int));
+        for (int i = 0; i < num_points; ++i) {
+            if (asteroid_grid_first_hit(g, arr, max_radius, points[i], cells,
+                                        max_cells) >= 0) {
+                num_hits += 1;
+            }
+        }
+        free(cells);
+    }
+    free(arr);
+    return num_hits;
+}
+
+void asteroid_points_inside_grid(vector ast, const double *x, const double *y,
+                                 int num_points, double max_radius, grid *g,
+                                 bool *inside) {
+    int num_asteroids = vector_length(&ast);
+    if (num_asteroids == 0) {
+        for (int i = 0; i < num_points; ++i) {
+            inside[i] = false;
+        }
+        return;
+    }
+    asteroid **arr = malloc((size_t)num_asteroids * sizeof(asteroid *));
+    for (int j = 0; j < num_asteroids; ++j) {
+        arr[j] = (asteroid *)vector_get(&ast, j);
+    }
+    grid_build(g, num_asteroids, asteroid_grid_pos, (const void *)arr);
+    int max_cells = asteroid_grid_max_cells(g, max_radius);
+    int *cells = malloc((size_t)max_cells * sizeof(int));
+    for (int i = 0; i < num_points; ++i) {
+        inside[i] = asteroid_grid_first_hit(g, arr, max_radius,
+                                            vec_create(x[i], y[i]), cells,
+                                            max_cells) >= 0;
+    }
+    free(cells);
+    free(arr);
+}
+
 vector asteroid_create_random_non_overlaping_asteroids(
     double radius, double vel_norm, double mass, double max_velocity, double dt,
     int num_asteroids, double x0, double x1, double y0, double y1) {
@@ -221,6 +406,122 @@ void asteroid_update_acceleration_periodic_all(vector asteroids, double grav,
     }
 }
 
+// whether the pair is far: as now, or as when acc_far was computed if it is
+// reused
+static bool asteroid_pair_is_far(const asteroid *const lhs,
+                                 const asteroid *const rhs, double distance,
+                                 double far_distance, bool reuse_far,
+                                 double x0, double x1, double y0, double y1) {
+    if (reuse_far) {
+        distance = vec_distance_periodic(lhs->pos_far, rhs->pos_far, x0, x1,
+                                         y0, y1);
+    }
+    return distance > far_distance;
+}
+
+// adds the acceleration of lhs due to rhs to acc_far instead of acc when
+// they are far apart, returns false if the pair is far and must be skipped
+static bool asteroid_update_acceleration_periodic_split(
+    asteroid *lhs, const asteroid *const rhs, bool far, double grav,
+    double repulse, bool reuse_far, double x0, double x1, double y0,
+    double y1) {
+    if (!far) {
+        asteroid_update_acceleration_periodic(lhs, rhs, grav, repulse, x0, x1,
+                                              y0, y1);
+        return true;
+    }
+    if (reuse_far) {
+        return false;
+    }
+    vec acc = lhs->acc;
+    lhs->acc = lhs->acc_far;
+    asteroid_update_acceleration_periodic(lhs, rhs, grav, repulse, x0, x1, y0,
+                                          y1);
+    lhs->acc_far = lhs->acc;
+    lhs->acc = acc;
+    return true;
+}
+
+static void asteroid_reset_acceleration_split(asteroid *a, bool reuse_far) {
+    asteroid_reset_acceleration(a);
+    if (!reuse_far) {
+        a->acc_far = vec_create_zero();
+    }
+}
+
+void asteroid_update_acceleration_periodic_split_all(
+    vector asteroids, double grav, double repulse, double far_distance,
+    bool reuse_far, double x0, double x1, double y0, double y1) {
+    int length = vector_length(&asteroids);
+    for (int ia = 0; ia < length; ++ia) {
+        asteroid_reset_acceleration_split(
+            (asteroid *)vector_get(&asteroids, ia), reuse_far);
+    }
+    for (int ia = 0; ia < length; ++ia) {
+        for (int ib = ia + 1; ib < length; ++ib) {
+            asteroid *ast_a = (asteroid *)vector_get(&asteroids, ia);
+            asteroid *ast_b = (asteroid *)vector_get(&asteroids, ib);
+            // reusing, the distance now is not needed
+            double distance =
+                reuse_far ? 0.0
+                          : vec_distance_periodic(ast_a->pos, ast_b->pos, x0,
+                                                  x1, y0, y1);
+            bool far = asteroid_pair_is_far(ast_a, ast_b, distance,
+                                            far_distance, reuse_far, x0, x1,
+                                            y0, y1);
+
+            if (asteroid_update_acceleration_periodic_split(
+                    ast_a, (const asteroid *const)ast_b, far, grav, repulse,
+                    reuse_far, x0, x1, y0, y1)) {
+                asteroid_update_acceleration_periodic_split(
+                    ast_b, (const asteroid *const)ast_a, far, grav, repulse,
+                    reuse_far, x0, x1, y0, y1);
+            }
+        }
+    }
+    for (int ia = 0; ia < length; ++ia) {
+        asteroid *ast = (asteroid *)vector_get(&asteroids, ia);
+        vec_add_inplace(&ast->acc, ast->acc_far);
+    }
+}
+
+double asteroid_update_acceleration_periodic_split_row(
+    vector asteroids, int ia, double grav, double repulse, double far_distance,
+    bool reuse_far, double x0, double x1, double y0, double y1) {
+    int length = vector_length(&asteroids);
+    double nearest = INFINITY;
+    asteroid *ast_a = (asteroid *)vector_get(&asteroids, ia);
+    asteroid_reset_acceleration_split(ast_a, reuse_far);
+    for (int ib = 0; ib < length; ++ib) {
+        if (ib == ia) {
+            continue;
+        }
+        asteroid *ast_b = (asteroid *)vector_get(&asteroids, ib);
+        double distance =
+            vec_distance_periodic(ast_a->pos, ast_b->pos, x0, x1, y0, y1);
+        nearest = distance < nearest ? distance : nearest;
+
+        bool far = asteroid_pair_is_far(ast_a, ast_b, distance, far_distance,
+                                        reuse_far, x0, x1, y0, y1);
+        asteroid_update_acceleration_periodic_split(
+            ast_a, (const asteroid *const)ast_b, far, grav, repulse,
+            reuse_far, x0, x1, y0, y1);
+    }
+    vec_add_inplace(&ast_a->acc, ast_a->acc_far);
+    return nearest;
+}
+
+void asteroid_update_acceleration_periodic_split_range(
+    vector asteroids, int begin, int end, double grav, double repulse,
+    double far_distance, bool reuse_far, double x0, double x1, double y0,
+    double y1) {
+    for (int ia = begin; ia < end; ++ia) {
+        asteroid_update_acceleration_periodic_split_row(
+            asteroids, ia, grav, repulse, far_distance, reuse_far, x0, x1, y0,
+            y1);
+    }
+}
+
 void asteroid_update_position_all(vector asteroids, double dt) {
     for (int ia = 0; ia < vector_length(&asteroids); ++ia) {
         asteroid_update_position((asteroid *)vector_get(&asteroids, ia), dt);
@@ -230,7 +531,14 @@ void asteroid_update_position_all(vector asteroids, double dt) {
 void asteroid_update_position_all_periodic(vector asteroids, double dt,
                                            double x0, double x1, double y0,
                                            double y1) {
-    for (int ia = 0; ia < vector_length(&asteroids); ++ia) {
+    asteroid_update_position_periodic_range(
+        asteroids, 0, vector_length(&asteroids), dt, x0, x1, y0, y1);
+}
+
+void asteroid_update_position_periodic_range(vector asteroids, int begin,
+                                             int end, double dt, double x0,
+                                             double x1, double y0, double y1) {
+    for (int ia = begin; ia < end; ++ia) {
         asteroid_update_position((asteroid *)vector_get(&asteroids, ia), dt);
         asteroid_make_periodic((asteroid *)vector_get(&asteroids, ia), x0, x1,
                                y0, y1);
@@ -2,7 +2,9 @@
 #define _ASTEROIDS_H_
 
 #include "../c_vector/vector.h"
+#include "../geom/grid.h"
 #include "../geom/vec.h"
+#include "debris.h"
 #include <stdbool.h>
 #include <pthread.h>
 
@@ -11,10 +13,16 @@ typedef struct _asteroid {
     vec pos;
     vec pos_m1;
     vec acc;
+    vec acc_far; // part of acc due to the asteroids further than far_distance
+    vec pos_far; // where acc_far was computed, to classify the pairs reusing it
+    bool far_computed; // acc_far computed since the asteroid was created
     double r;
     double mass;
     int generation;
     double max_velocity;
+    int lod_step;      // ticks covered by a step, more than 1 far from the vessel
+    int lod_countdown; // ticks before the next step of a far asteroid
+    int frozen_steps;  // steps of a far asteroid left without forces
     pthread_mutex_t mutex;
 } asteroid;
 
@@ -27,9 +35,31 @@ asteroid *asteroid_create_with_velocity(vec pos, double r, vec vel, vec acc,
 
 vector asteroid_create_two_asteroids_from_parent(const asteroid *const ast, double dt);
 
-vector asteroid_blow(asteroid **ast, double dt);
+// the asteroids of the last generation leave particles in d, if not NULL
+vector asteroid_blow(asteroid **ast, double dt, debris *d);
 
-void asteroid_blown_by_bullets(vector *ast, vector *bullets, double dt);
+// position one tick earlier, whatever the step of the asteroid
+vec asteroid_prev_pos(const asteroid *const ast);
+
+void asteroid_blown_by_bullets(vector *ast, vector *bullets, double dt,
+                               debris *d);
+
+// same as asteroid_blown_by_bullets, looking for the asteroids around each
+// bullet in g (rebuilt here). max_radius bounds the radius of the asteroids.
+void asteroid_blown_by_bullets_grid(vector *ast, vector *bullets, double dt,
+                                    double max_radius, grid *g, debris *d);
+
+// number of points inside an asteroid, looked up in g or by brute force if g
+// is NULL
+int asteroid_count_hits_grid(vector ast, const vec *points, int num_points,
+                             double max_radius, grid *g);
+
+// sets inside[i] if (x[i], y[i]) is inside an asteroid, looking for the
+// asteroids around each point in g (rebuilt here). max_radius bounds the
+// radius of the asteroids.
+void asteroid_points_inside_grid(vector ast, const double *x, const double *y,
+                                 int num_points, double max_radius, grid *g,
+                                 bool *inside);
 
 vector asteroid_create_random_non_overlaping_asteroids(
     double radius, double vel_norm, double mass, double max_velocity, double dt,
@@ -49,6 +79,9 @@ void asteroid_update_position(asteroid *ast, double dt);
 
 void asteroid_move(asteroid *ast, double dt);
 
+void asteroid_make_periodic(asteroid *ast, double x0, double x1, double y0,
+                            double y1);
+
 bool asteroid_is_inside(const asteroid *const ast, vec rhs);
 
 void asteroid_destroy(asteroid **ast);
@@ -62,10 +95,36 @@ void asteroid_update_acceleration_periodic_all(vector asteroids, double grav,
                                                double repulse, double x0,
                                                double x1, double y0, double y1);
 
+// same as asteroid_update_acceleration_periodic_all, but the pairs further
+// apart than far_distance are either recomputed into acc_far, or skipped
+// and the acc_far of the previous computation is reused. When reusing, a
+// pair is far if it was at that computation, from the pos_far of both
+// asteroids, so that each pair is counted exactly once.
+void asteroid_update_acceleration_periodic_split_all(
+    vector asteroids, double grav, double repulse, double far_distance,
+    bool reuse_far, double x0, double x1, double y0, double y1);
+
+// acceleration of the ia-th asteroid from all the others, returns the
+// distance to the closest one
+double asteroid_update_acceleration_periodic_split_row(
+    vector asteroids, int ia, double grav, double repulse, double far_distance,
+    bool reuse_far, double x0, double x1, double y0, double y1);
+
+// computes from scratch the acceleration of the asteroids [begin, end) due to
+// all the others, so that disjoint ranges can be updated concurrently
+void asteroid_update_acceleration_periodic_split_range(
+    vector asteroids, int begin, int end, double grav, double repulse,
+    double far_distance, bool reuse_far, double x0, double x1, double y0,
+    double y1);
+
 void asteroid_update_position_all(vector ast, double dt);
 
 void asteroid_update_position_all_periodic(vector asteroids, double dt,
                                            double x0, double x1, double y0,
                                            double y1);
 
+void asteroid_update_position_periodic_range(vector asteroids, int begin,
+                                             int end, double dt, double x0,
+                                             double x1, double y0, double y1);
+
 #endif
@@ -0,0 +1,179 @@
+#include "debris.h"
+#include "../geom/utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int default_per_asteroid = 256;
+static const int default_max_particles = 1 << 18;
+static const float default_lifetime = 1.5f;
+// fastest a particle leaves the asteroid at, relative to it
+static const double burst_speed = 0.1;
+static const unsigned int debris_seed = 1729;
+
+static double debris_rand(unsigned int *seed) {
+    return (double)rand_r(seed) / ((double)RAND_MAX + 1.0);
+}
+
+debris debris_create_default() {
+    debris d = (debris){0};
+    d.per_asteroid = default_per_asteroid;
+    d.max_particles = default_max_particles;
+    d.lifetime = default_lifetime;
+    d.seed = debris_seed;
+    return d;
+}
+
+bool debris_parse_arg(debris *d, const char *arg) {
+    if (strncmp(arg, "--debris=", 9) == 0) {
+        int per_asteroid = atoi(arg + 9);
+        d->per_asteroid = per_asteroid < 0 ? 0 : per_asteroid;
+        return true;
+    }
+    if (strncmp(arg, "--debris-max=", 13) == 0) {
+        int max_particles = atoi(arg + 13);
+        d->max_particles =
+            max_particles < 1 ? default_max_particles : max_particles;
+        return true;
+    }
+    if (strncmp(arg, "--debris-life=", 14) == 0) {
+        float lifetime = (float)atof(arg + 14);
+        d->lifetime = lifetime > 0.0f ? lifetime : default_lifetime;
+        return true;
+    }
+    return false;
+}
+
+static bool debris_reserve(debris *d) {
+    if (d->capacity > 0) {
+        return true;
+    }
+    size_t size = (size_t)d->max_particles * sizeof(float);
+    d->x = malloc(size);
+    d->y = malloc(size);
+    d->vx = malloc(size);
+    d->vy = malloc(size);
+    d->life = malloc(size);
+    if (d->x == NULL || d->y == NULL || d->vx == NULL || d->vy == NULL ||
+        d->life == NULL) {
+        debris_free(d);
+        d->per_asteroid = 0;
+        return false;
+    }
+    d->capacity = d->max_particles;
+    return true;
+}
+
+void debris_spawn(debris *d, vec pos, vec vel, double r) {
+    if (d->per_asteroid == 0 || !debris_reserve(d)) {
+        return;
+    }
+    for (int i = 0; i < d->per_asteroid; ++i) {
+        if (d->length == d->capacity) {
+            d->head = (d->head + 1) % d->capacity;
+            d->length -= 1;
+            d->overwritten += 1;
+        }
+        int k = (d->head + d->length) % d->capacity;
+        // uniform in the disc
+        double rho = r * sqrt(debris_rand(&d->seed));
+        double theta = 2.0 * PI * debris_rand(&d->seed);
+        double speed = burst_speed * sqrt(debris_rand(&d->seed));
+        double phi = 2.0 * PI * debris_rand(&d->seed);
+        d->x[k] = (float)(pos.x + rho * cos(theta));
+        d->y[k] = (float)(pos.y + rho * sin(theta));
+        d->vx[k] = (float)(vel.x + speed * cos(phi));
+        d->vy[k] = (float)(vel.y + speed * sin(phi));
+        d->life[k] = d->lifetime;
+        d->length += 1;
+    }
+    d->spawned += (unsigned long)d->per_asteroid;
+    d->peak = d->length > d->peak ? d->length : d->peak;
+}
+
+// one contiguous run of the ring. The periodic wrap selects the shift
+// rather than the position, so that the loop is vectorized; a particle
+// never crosses more than one edge in a tick.
+static void debris_advect(float *restrict x, float *restrict y,
+                          const float *restrict vx, const float *restrict vy,
+                          float *restrict life, int n, float dt, float x0,
+                          float x1, float y0, float y1) {
+    float width = x1 - x0;
+    float height = y1 - y0;
+    for (int i = 0; i < n; ++i) {
+        float px = x[i] + dt * vx[i];
+        float py = y[i] + dt * vy[i];
+        float right = px < x0 ? width : 0.0f;
+        float left = px >= x1 ? width : 0.0f;
+        float up = py < y0 ? height : 0.0f;
+        float down = py >= y1 ? height : 0.0f;
+        x[i] = px + right - left;
+        y[i] = py + up - down;
+        life[i] -= dt;
+    }
+}
+
+void debris_update(debris *d, double dt, double x0, double x1, double y0,
+                   double y1) {
+    if (d->length == 0) {
+        return;
+    }
+    int first = d->capacity - d->head;
+    first = d->length < first ? d->length : first;
+    debris_advect(d->x + d->head, d->y + d->head, d->vx + d->head,
+                  d->vy + d->head, d->life + d->head, first, (float)dt,
+                  (float)x0, (float)x1, (float)y0, (float)y1);
+    debris_advect(d->x, d->y, d->vx, d->vy, d->life, d->length - first,
+                  (float)dt, (float)x0, (float)x1, (float)y0, (float)y1);
+
+    // the oldest die first
+    while (d->length > 0 && d->life[d->head] <= 0.0f) {
+        d->head = (d->head + 1) % d->capacity;
+        d->length -= 1;
+    }
+    d->updates += 1;
+}
+
+void debris_draw(debris *d, debris_draw_fn draw, void *ctx) {
+    if (d->length == 0) {
+        return;
+    }
+    int first = d->capacity - d->head;
+    first = d->length < first ? d->length : first;
+    draw(ctx, d->head, first);
+    if (d->length > first) {
+        draw(ctx, 0, d->length - first);
+    }
+    d->draws += 1;
+    d->drawn += (unsigned long)d->length;
+}
+
+void debris_print(const debris *d, FILE *out) {
+    if (d->spawned == 0) {
+        return;
+    }
+    fprintf(out,
+            "debris: %lu particles, %d at most (%lu overwritten), moved over "
+            "%lu ticks",
+            d->spawned, d->peak, d->overwritten, d->updates);
+    if (d->draws > 0) {
+        fprintf(out, ", %.0f drawn per frame", (double)d->drawn / (double)d->draws);
+    }
+    fprintf(out, "\n");
+}
+
+void debris_free(debris *d) {
+    free(d->x);
+    free(d->y);
+    free(d->vx);
+    free(d->vy);
+    free(d->life);
+    d->x = NULL;
+    d->y = NULL;
+    d->vx = NULL;
+    d->vy = NULL;
+    d->life = NULL;
+    d->capacity = 0;
+    d->head = 0;
+    d->length = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef _DEBRIS_H_
+#define _DEBRIS_H_
+
+#include "../geom/vec.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// called on each contiguous run [begin, begin + length) of the particles
+typedef void (*debris_draw_fn)(void *ctx, int begin, int length);
+
+// Particles left by the asteroids of the last generation when they are
+// destroyed. They only drift and fade, without forces nor collisions, so
+// they are kept as arrays of floats, one per coordinate, moved by loops
+// the compiler vectorizes. All of them live for the same time, thus die in
+// the order they were born: they are kept in a ring, the oldest at head,
+// and expire by moving head. When the ring is full, the oldest particles
+// give their place to the new ones. The debris does not time itself, its
+// callers time the stages they run it in.
+typedef struct _debris {
+    int per_asteroid;  // particles left by an asteroid, 0 for none
+    int max_particles; // capacity of the ring
+    float lifetime;    // seconds
+    float *x;
+    float *y;
+    float *vx;
+    float *vy;
+    float *life; // seconds left
+    int head;
+    int length;
+    int capacity;
+    unsigned int seed;
+    unsigned long spawned;
+    unsigned long overwritten;
+    int peak;
+    unsigned long updates;
+    unsigned long draws;
+    unsigned long drawn;
+} debris;
+
+debris debris_create_default();
+
+// handles --debris=<n>, --debris-max=<n> and --debris-life=<seconds>,
+// returns false if arg is not for the debris
+bool debris_parse_arg(debris *d, const char *arg);
+
+// bursts of per_asteroid particles inside a disc of radius r at pos,
+// moving at vel plus a random spread
+void debris_spawn(debris *d, vec pos, vec vel, double r);
+
+// moves the particles by dt in the periodic world [x0, x1] x [y0, y1] and
+// drops the expired ones
+void debris_update(debris *d, double dt, double x0, double x1, double y0,
+                   double y1);
+
+// calls draw on the particles, oldest first
+void debris_draw(debris *d, debris_draw_fn draw, void *ctx);
+
+void debris_print(const debris *d, FILE *out);
+
+void debris_free(debris *d);
+
+#endif
@@ -0,0 +1,523 @@
+#include "../asteroids/asteroid_lod.h"
+#include "../asteroids/asteroids.h"
+#include "../asteroids/debris.h"
+#include "../c_vector/vector.h"
+#include "../geom/dyn_params.h"
+#include "../geom/grid.h"
+#include "../geom/sim_clock.h"
+#include "../geom/utils.h"
+#include "../graphics/latency_stats.h"
+#include "../threads/ast_params.h"
+#include "../threads/bullets_params.h"
+#include "../threads/worker_pool.h"
+#include "../vessel/bullet.h"
+#include "../vessel/vessel.h"
+#include "../vessel/vessel_batch.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Runs the simulation without any window nor render, one tick after the
+// other as fast as possible, to measure its throughput. With --capacity it
+// adds asteroids in waves until the ticks no longer fit in their budget.
+
+// asteroids per unit of area, as in the game
+static const double asteroids_per_area = 4.0;
+// ticks of a wave not measured, while the stages adapt to the population
+static const int warmup_ticks = 4;
+// a wave breaches the budget when more of its ticks than this run over
+static const double breach_ratio = 0.5;
+// smallest wave added when it is a quarter of the population
+static const int min_wave = 16;
+
+typedef enum {
+    stage_vessel,
+    stage_acceleration,
+    stage_collisions,
+    stage_positions,
+    stage_bullets,
+    stage_debris,
+    num_stages
+} sim_stage;
+
+static const char *stage_names[num_stages] = {
+    "vessel", "acceleration", "collisions", "positions", "bullets",
+    "debris"};
+
+typedef struct _sim_bench_options {
+    int num_asteroids;
+    double bullet_rate; // bullets fired per tick
+    int steps;
+    int num_threads; // the calling thread included
+    unsigned int seed;
+    bool capacity;       // look for the largest population in the budget
+    double tick_rate;    // ticks per second the capacity is measured at
+    int wave;            // asteroids added per wave, 0 for a quarter
+    int wave_ticks;      // ticks measured per wave
+    int max_asteroids;   // the search stops there
+    const char *certificate; // file the capacity is appended to
+    asteroid_lod lod;        // of the asteroid stages
+    debris deb;              // left by the asteroids destroyed
+    vessel_batch vessels;    // the bots besides the vessel
+} sim_bench_options;
+
+typedef struct _sim_bench {
+    dyn_params params;
+    vector ast;
+    vector bullets;
+    vessel_batch vessels;
+    worker_pool *pool;
+    ast_params ap;
+    bullets_params bp;
+    grid collision_grid;
+    debris deb;
+    double bullet_rate;
+    double fire_credit;
+    unsigned int fire_seed;
+} sim_bench;
+
+static double sim_bench_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+static sim_bench_options sim_bench_options_create_default() {
+    sim_bench_options opts;
+    opts.num_asteroids = 256;
+    opts.bullet_rate = 1.0;
+    opts.steps = 1000;
+    opts.num_threads = worker_pool_default_num_threads() + 1;
+    opts.seed = 1;
+    opts.capacity = false;
+    opts.tick_rate = 24.0;
+    opts.wave = 0;
+    opts.wave_ticks = 48;
+    opts.max_asteroids = 1 << 20;
+    opts.certificate = NULL;
+    opts.lod = asteroid_lod_create_default();
+    opts.deb = debris_create_default();
+    opts.vessels = vessel_batch_create_default();
+    return opts;
+}
+
+static bool sim_bench_parse_arg(sim_bench_options *opts, const char *arg) {
+    if (strncmp(arg, "--asteroids=", 12) == 0) {
+        opts->num_asteroids = atoi(arg + 12);
+        if (opts->num_asteroids < 1) {
+            opts->num_asteroids = 1;
+        }
+    } else if (strncmp(arg, "--bullet-rate=", 14) == 0) {
+        opts->bullet_rate = atof(arg + 14);
+        if (opts->bullet_rate < 0.0) {
+            opts->bullet_rate = 0.0;
+        }
+    } else if (strncmp(arg, "--steps=", 8) == 0) {
+        opts->steps = atoi(arg + 8);
+        if (opts->steps < 1) {
+            opts->steps = 1;
+        }
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+        opts->num_threads = atoi(arg + 10);
+        if (opts->num_threads < 1) {
+            opts->num_threads = 1;
+        }
+    } else if (strncmp(arg, "--seed=", 7) == 0) {
+        opts->seed = (unsigned int)strtoul(arg + 7, NULL, 10);
+    } else if (strcmp(arg, "--capacity") == 0) {
+        opts->capacity = true;
+    } else if (strncmp(arg, "--tick-rate=", 12) == 0) {
+        opts->tick_rate = atof(arg + 12);
+        if (opts->tick_rate <= 0.0) {
+            opts->tick_rate = 24.0;
+        }
+    } else if (strncmp(arg, "--wave=", 7) == 0) {
+        opts->wave = atoi(arg + 7);
+        if (opts->wave < 0) {
+            opts->wave = 0;
+        }
+    } else if (strncmp(arg, "--wave-ticks=", 13) == 0) {
+        opts->wave_ticks = atoi(arg + 13);
+        if (opts->wave_ticks < 1) {
+            opts->wave_ticks = 1;
+        }
+    } else if (strncmp(arg, "--max-asteroids=", 16) == 0) {
+        opts->max_asteroids = atoi(arg + 16);
+    } else if (strncmp(arg, "--certificate=", 14) == 0) {
+        opts->certificate = arg + 14;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static double sim_bench_rand(unsigned int *seed, double r0, double r1) {
+    return r0 + (r1 - r0) * rand_r(seed) / RAND_MAX;
+}
+
+// as crowded as the game, whatever the number of asteroids
+static void sim_bench_fit_world(sim_bench *sb, int num_asteroids) {
+    dyn_params *params = &sb->params;
+    double side = sqrt(num_asteroids / asteroids_per_area);
+    if (side > params->pos_max.x - params->pos_min.x) {
+        params->pos_max =
+            vec_create(params->pos_min.x + side, params->pos_min.y + side);
+        grid_free(&sb->collision_grid);
+        sb->collision_grid = grid_create_with_cell_size(
+            2.0 * params->asteroid_radius, params->pos_min.x,
+            params->pos_max.x, params->pos_min.y, params->pos_max.y);
+    }
+}
+
+// count asteroids at random places of the whole world, none overlapping any
+// other, replacing the previous ones
+static void sim_bench_populate(sim_bench *sb, int count) {
+    const dyn_params *params = &sb->params;
+    double x0 = params->pos_min.x, x1 = params->pos_max.x;
+    double y0 = params->pos_min.y, y1 = params->pos_max.y;
+    vector_empty(&sb->ast);
+    for (int i = 0; i < count; ++i) {
+        vec pos = vec_create_rand(x0, x1, y0, y1);
+        for (int ia = 0; ia < i; ++ia) {
+            const asteroid *ast = (const asteroid *)vector_get(&sb->ast, ia);
+            if (vec_distance_periodic(ast->pos, pos, x0, x1, y0, y1) <
+                ast->r + params->asteroid_radius) {
+                pos = vec_create_rand(x0, x1, y0, y1);
+                ia = -1;
+            }
+        }
+        double theta = double_rand_inrange(0, 2 * PI);
+        vec vel = vec_scale(vec_create(cos(theta), sin(theta)),
+                            params->asteroid_vel);
+        vector_push(&sb->ast, (void *)asteroid_create_with_velocity(
+                                  pos, params->asteroid_radius, vel,
+                                  vec_create_zero(), params->asteroid_mass,
+                                  params->asteroid_max_vel, 0, params->dt));
+    }
+}
+
+static void sim_bench_create(sim_bench *sb, const sim_bench_options *opts) {
+    srand(opts->seed);
+    sb->fire_seed = opts->seed;
+    sb->bullet_rate = opts->bullet_rate;
+    sb->fire_credit = 0.0;
+
+    sb->params = dyn_params_create_default();
+    dyn_params *params = &sb->params;
+    sb->collision_grid = grid_create_with_cell_size(
+        2.0 * params->asteroid_radius, params->pos_min.x, params->pos_max.x,
+        params->pos_min.y, params->pos_max.y);
+    sim_bench_fit_world(sb, opts->num_asteroids);
+    params->vessel_pos =
+        vec_scale(vec_add(params->pos_min, params->pos_max), 0.5);
+
+    vector_init(&sb->ast);
+    sim_bench_populate(sb, opts->num_asteroids);
+    // never game over, the vessels only get blown
+    sb->vessels = opts->vessels;
+    vessel_batch_add(&sb->vessels, params->vessel_pos, INT_MAX, params);
+    // turns in circles, always thrusting
+    sb->vessels.actions[0] =
+        ACTION_BIT(turn_left) | ACTION_BIT(front_boost);
+    vessel_batch_add_bots(&sb->vessels, INT_MAX, params);
+    vector_init(&sb->bullets);
+
+    sb->pool = worker_pool_create(opts->num_threads - 1);
+    sb->ap = ast_params_create(&sb->ast, &sb->bullets, params, sb->pool);
+    sb->ap.lod = opts->lod;
+    sb->deb = opts->deb;
+    sb->bp = bullets_params_create(&sb->bullets, params, sb->pool);
+}
+
+// the world grows with them, so that the density stays the same. The whole
+// population is placed again in the grown world, rather than the new
+// asteroids added next to the old ones left in its first corner
+static void sim_bench_add_asteroids(sim_bench *sb, int count) {
+    int population = vector_length(&sb->ast) + count;
+    sim_bench_fit_world(sb, population);
+    sim_bench_populate(sb, population);
+}
+
+// synthetic fire: bullets from random places in random directions
+static void sim_bench_fire(sim_bench *sb) {
+    const dyn_params *params = &sb->params;
+    sb->fire_credit += sb->bullet_rate;
+    int count = (int)sb->fire_credit;
+    sb->fire_credit -= count;
+    for (int i = 0; i < count; ++i) {
+        vec pos = vec_create(sim_bench_rand(&sb->fire_seed, params->pos_min.x,
+                                            params->pos_max.x),
+                             sim_bench_rand(&sb->fire_seed, params->pos_min.y,
+                                            params->pos_max.y));
+        double theta = sim_bench_rand(&sb->fire_seed, 0.0, 2.0 * PI);
+        vec vel = vec_create(params->bullet_vel * cos(theta),
+                             params->bullet_vel * sin(theta));
+        vector_push(&sb->bullets,
+                    bullet_create(pos, vel, params->bullet_max_distance));
+    }
+}
+
+// one tick, in the order of the game, adding the time of each stage
+static double sim_bench_tick(sim_bench *sb, double stage_time[num_stages]) {
+    dyn_params *params = &sb->params;
+    double t0 = sim_bench_now();
+    sim_bench_fire(sb);
+    vessel_batch_bot_actions(&sb->vessels, 1, &params->clock);
+    vessel_batch_step(&sb->vessels, &sb->bullets, params);
+    sb->ap.lod.focus = vessel_batch_pos(&sb->vessels, 0);
+    double t1 = sim_bench_now();
+    ast_params_update_acceleration(&sb->ap);
+    double t2 = sim_bench_now();
+    asteroid_blown_by_bullets_grid(&sb->ast, &sb->bullets, params->dt,
+                                   params->asteroid_radius,
+                                   &sb->collision_grid, &sb->deb);
+    vessel_batch_blown_by_asteroids(&sb->vessels, sb->ast,
+                                    params->asteroid_radius,
+                                    &sb->collision_grid, &params->clock);
+    double t3 = sim_bench_now();
+    ast_params_update_position(&sb->ap);
+    double t4 = sim_bench_now();
+    bullets_params_move(&sb->bp);
+    bullet_destroy_after_travel(&sb->bullets);
+    double t5 = sim_bench_now();
+    debris_update(&sb->deb, params->dt, params->pos_min.x, params->pos_max.x,
+                  params->pos_min.y, params->pos_max.y);
+    double t6 = sim_bench_now();
+    sim_clock_advance(&params->clock);
+
+    stage_time[stage_vessel] += t1 - t0;
+    stage_time[stage_acceleration] += t2 - t1;
+    stage_time[stage_collisions] += t3 - t2;
+    stage_time[stage_positions] += t4 - t3;
+    stage_time[stage_bullets] += t5 - t4;
+    stage_time[stage_debris] += t6 - t5;
+    return t6 - t0;
+}
+
+static void sim_bench_free(sim_bench *sb) {
+    worker_pool_destroy(&sb->pool);
+    asteroid_lod_free(&sb->ap.lod);
+    debris_free(&sb->deb);
+    vessel_batch_free(&sb->vessels);
+    grid_free(&sb->collision_grid);
+    vector_free(&sb->ast);
+    vector_free(&sb->bullets);
+}
+
+static void sim_bench_run(sim_bench *sb, const sim_bench_options *opts) {
+    double stage_time[num_stages] = {0.0};
+    double entity_updates = 0.0;
+    double start = sim_bench_now();
+    for (int step = 0; step < opts->steps; ++step) {
+        sim_bench_tick(sb, stage_time);
+        entity_updates +=
+            vector_length(&sb->ast) + vector_length(&sb->bullets) +
+            sb->vessels.length;
+    }
+    double elapsed = sim_bench_now() - start;
+
+    printf("%d ticks in %.3f s: %.1f ticks/s, %.3g entity updates/s\n",
+           opts->steps, elapsed, opts->steps / elapsed,
+           entity_updates / elapsed);
+    printf("left: %d asteroids, %d bullets, %lu lifes lost\n",
+           vector_length(&sb->ast), vector_length(&sb->bullets),
+           sb->vessels.blown);
+    for (int s = 0; s < num_stages; ++s) {
+        printf("  %-12s %8.3f ms per tick\n", stage_names[s],
+               1000.0 * stage_time[s] / opts->steps);
+    }
+    asteroid_lod_print(&sb->ap.lod, stdout);
+    debris_print(&sb->deb, stdout);
+    vessel_batch_print(&sb->vessels, stdout);
+}
+
+// measures of the ticks of a wave
+typedef struct _sim_wave {
+    int asteroids; // on average over the wave
+    int bullets;
+    double stage_time[num_stages]; // per tick
+    double p50;
+    double p99;
+    double over_budget; // fraction of the ticks
+} sim_wave;
+
+static double sim_wave_tick_time(const sim_wave *wave) {
+    double total = 0.0;
+    for (int s = 0; s < num_stages; ++s) {
+        total += wave->stage_time[s];
+    }
+    return total;
+}
+
+static int sim_wave_bottleneck(const sim_wave *wave) {
+    int worst = 0;
+    for (int s = 1; s < num_stages; ++s) {
+        if (wave->stage_time[s] > wave->stage_time[worst]) {
+            worst = s;
+        }
+    }
+    return worst;
+}
+
+static sim_wave sim_bench_measure_wave(sim_bench *sb,
+                                       const sim_bench_options *opts,
+                                       double budget) {
+    double warmup[num_stages] = {0.0};
+    for (int i = 0; i < warmup_ticks; ++i) {
+        sim_bench_tick(sb, warmup);
+    }
+    sim_wave wave = (sim_wave){0};
+    latency_stats ticks = latency_stats_create();
+    double asteroids = 0.0;
+    double bullets = 0.0;
+    int num_over = 0;
+    for (int i = 0; i < opts->wave_ticks; ++i) {
+        double tick = sim_bench_tick(sb, wave.stage_time);
+        latency_stats_add(&ticks, tick);
+        num_over += tick > budget;
+        asteroids += vector_length(&sb->ast);
+        bullets += vector_length(&sb->bullets);
+    }
+    for (int s = 0; s < num_stages; ++s) {
+        wave.stage_time[s] /= opts->wave_ticks;
+    }
+    wave.asteroids = (int)(asteroids / opts->wave_ticks + 0.5);
+    wave.bullets = (int)(bullets / opts->wave_ticks + 0.5);
+    wave.p50 = latency_stats_percentile(&ticks, 0.5);
+    wave.p99 = latency_stats_percentile(&ticks, 0.99);
+    wave.over_budget = (double)num_over / opts->wave_ticks;
+    latency_stats_free(&ticks);
+    return wave;
+}
+
+static void sim_wave_print(const sim_wave *wave, int index, FILE *out) {
+    fprintf(out, "%4d %9d %8d %8.2f %8.2f %6.0f%%", index, wave->asteroids,
+            wave->bullets, 1000.0 * wave->p50, 1000.0 * wave->p99,
+            100.0 * wave->over_budget);
+    for (int s = 0; s < num_stages; ++s) {
+        fprintf(out, " %12.2f", 1000.0 * wave->stage_time[s]);
+    }
+    fprintf(out, "\n");
+}
+
+static void sim_bench_certify(const sim_bench_options *opts,
+                              const sim_wave *sustained, int bottleneck) {
+    FILE *f = fopen(opts->certificate, "a");
+    if (f == NULL) {
+        fprintf(stderr, "cannot write the certificate %s\n",
+                opts->certificate);
+        return;
+    }
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    fprintf(f,
+            "host=%s cpus=%ld threads=%d tick_rate=%.6g seed=%u -> "
+            "asteroids=%d bullets=%d bottleneck=%s\n",
+            host, sysconf(_SC_NPROCESSORS_ONLN), opts->num_threads,
+            opts->tick_rate, opts->seed,
+            sustained != NULL ? sustained->asteroids : 0,
+            sustained != NULL ? sustained->bullets : 0,
+            stage_names[bottleneck]);
+    fclose(f);
+}
+
+// adds asteroids and fire in waves until the ticks keep running over the
+// budget, the last wave within it giving the capacity of the host
+static void sim_bench_find_capacity(sim_bench *sb,
+                                    const sim_bench_options *opts) {
+    double budget = 1.0 / opts->tick_rate;
+    double bullets_per_asteroid = opts->bullet_rate / opts->num_asteroids;
+    printf("capacity at %.6g ticks/s (%.2f ms per tick), a wave breaching it "
+           "when more than %.0f%% of its %d ticks run over\n",
+           opts->tick_rate, 1000.0 * budget, 100.0 * breach_ratio,
+           opts->wave_ticks);
+    printf("wave asteroids  bullets  p50 (ms) p99 (ms)   over");
+    for (int s = 0; s < num_stages; ++s) {
+        printf(" %12s", stage_names[s]);
+    }
+    printf("\n");
+
+    sim_wave sustained = (sim_wave){0};
+    bool found = false;
+    sim_wave wave = (sim_wave){0};
+    bool breached = false;
+    for (int index = 0;; ++index) {
+        wave = sim_bench_measure_wave(sb, opts, budget);
+        sim_wave_print(&wave, index, stdout);
+        if (wave.over_budget > breach_ratio) {
+            breached = true;
+            break;
+        }
+        sustained = wave;
+        found = true;
+
+        int population = vector_length(&sb->ast);
+        int count = opts->wave > 0 ? opts->wave : population / 4;
+        count = count < min_wave ? min_wave : count;
+        if (population + count > opts->max_asteroids) {
+            break;
+        }
+        sim_bench_add_asteroids(sb, count);
+        // the fire grows with the population
+        sb->bullet_rate = bullets_per_asteroid * (population + count);
+    }
+
+    int bottleneck = sim_wave_bottleneck(&wave);
+    if (found) {
+        printf("sustained: %d asteroids and %d bullets\n",
+               sustained.asteroids, sustained.bullets);
+    } else {
+        printf("sustained: not even the first wave\n");
+    }
+    if (breached) {
+        printf("breached at %d asteroids and %d bullets, bottleneck %s "
+               "(%.0f%% of the tick)\n",
+               wave.asteroids, wave.bullets, stage_names[bottleneck],
+               100.0 * wave.stage_time[bottleneck] /
+                   sim_wave_tick_time(&wave));
+    } else {
+        printf("no breach up to %d asteroids\n", opts->max_asteroids);
+    }
+    if (opts->certificate != NULL) {
+        sim_bench_certify(opts, found ? &sustained : NULL, bottleneck);
+    }
+}
+
+/// Benchmark entry point.
+/// @param argc number of command line arguments.
+/// @param argv --asteroids=<n>, --bullet-rate=<per tick>, --steps=<n>,
+/// --threads=<n>, --seed=<n>, and for the capacity --capacity,
+/// --tick-rate=<hz>, --wave=<n>, --wave-ticks=<n>, --max-asteroids=<n> and
+/// --certificate=<file> (see asteroid_lod.h for the level of detail,
+/// debris.h for the particles and vessel_batch.h for the bots).
+/// @return the application status code (0 if success).
+int main(int argc, char **argv) {
+    sim_bench_options opts = sim_bench_options_create_default();
+    for (int i = 1; i < argc; ++i) {
+        if (!sim_bench_parse_arg(&opts, argv[i]) &&
+            !asteroid_lod_parse_arg(&opts.lod, argv[i]) &&
+            !debris_parse_arg(&opts.deb, argv[i]) &&
+            !vessel_batch_parse_arg(&opts.vessels, argv[i])) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+        }
+    }
+
+    sim_bench sb;
+    sim_bench_create(&sb, &opts);
+    printf("%d asteroids in a %.1f x %.1f world, %.2f bullets per tick, "
+           "%d threads, seed %u\n",
+           opts.num_asteroids, sb.params.pos_max.x - sb.params.pos_min.x,
+           sb.params.pos_max.y - sb.params.pos_min.y, opts.bullet_rate,
+           opts.num_threads, opts.seed);
+    if (opts.capacity) {
+        sim_bench_find_capacity(&sb, &opts);
+    } else {
+        sim_bench_run(&sb, &opts);
+    }
+    sim_bench_free(&sb);
+    return EXIT_SUCCESS;
+}
@@ -1,4 +1,5 @@
 #include "vector.h"
+#include "../threads/lock_prof.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -13,7 +14,7 @@ void vector_init(vector *v) {
 }
 
 int vector_length(vector *v) {
-    pthread_mutex_lock(v->mutex);
+    PROF_MUTEX_LOCK(v->mutex, "vector");
     int length = v->length;
     pthread_mutex_unlock(v->mutex);
     return length;
@@ -31,7 +32,7 @@ static void vector_resize(vector *v, int capacity) {
 }
 
 void vector_push(vector *v, void *element) {
-    pthread_mutex_lock(v->mutex);
+    PROF_MUTEX_LOCK(v->mutex, "vector");
     if (v->capacity == v->length)
         vector_resize(v, v->capacity * 2);
     v->content[v->length] = element;
@@ -40,14 +41,14 @@ void vector_push(vector *v, void *element) {
 }
 
 void vector_set(vector *v, int index, void *element) {
-    pthread_mutex_lock(v->mutex);
+    PROF_MUTEX_LOCK(v->mutex, "vector");
     if (index >= 0 && index < v->length)
         v->content[index] = element;
     pthread_mutex_unlock(v->mutex);
 }
 
 void *vector_get(vector *v, int index) {
-    pthread_mutex_lock(v->mutex);
+    PROF_MUTEX_LOCK(v->mutex, "vector");
     if (index >= 0 && index < v->length) {
         void *element = v->content[index];
         pthread_mutex_unlock(v->mutex);
@@ -58,7 +59,7 @@ void *vector_get(vector *v, int index) {
 }
 
 void *vector_remove(vector *v, int index) {
-    pthread_mutex_lock(v->mutex);
+    PROF_MUTEX_LOCK(v->mutex, "vector");
     if (index < 0 || index >= v->length) {
         pthread_mutex_unlock(v->mutex);
         return NULL;
@@ -94,7 +95,7 @@ void vector_empty(vector *v) {
 }
 
 void vector_free(vector *v) {
-    pthread_mutex_lock(v->mutex);
+    PROF_MUTEX_LOCK(v->mutex, "vector");
     for (int i = 0; i < v->length; ++i) {
         free(v->content[i]);
         v->content[i] = NULL;
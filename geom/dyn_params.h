@@ -2,14 +2,17 @@
 #define _DYN_PARAMS_H_
 
 #include "../geom/vec.h"
+#include "sim_clock.h"
 #include <stdbool.h>
 
 typedef struct _dyn_params {
     double dt;
+    sim_clock clock; // advanced by the main thread after each tick
     double grav;
     double repulse;
     vec pos_min;
     vec pos_max;
+    double far_distance; // beyond it, forces can be reused when overloaded
 
     double asteroid_radius;
     double asteroid_vel;
@@ -21,9 +24,7 @@ typedef struct _dyn_params {
     double vessel_mass;
     double vessel_max_vel;
     double vessel_max_ang_vel;
-    double vessel_ang_acc;
     double vessel_delta_ang_acc;
-    double vessel_lin_acc;
     double vessel_delta_lin_acc;
     int vessel_remaining_lifes;
     double vessel_inv_time;
@@ -31,7 +32,6 @@ typedef struct _dyn_params {
 
     double bullet_vel;
     double bullet_max_distance;
-    bool bullet_try_fire;
 
     bool game_ended;
     pthread_mutex_t mutex_game_ended;
@@ -40,6 +40,8 @@ typedef struct _dyn_params {
     bool ast_render_finished;
     bool blt_render_finished;
     int counter_update;
+    bool reuse_far_forces; // degraded mode, read with mutex_update
+    vec lod_focus;         // vessel position at the last tick, same
     pthread_cond_t cond_update;
     pthread_mutex_t mutex_update;
 } dyn_params;
@@ -51,12 +53,12 @@ dyn_params dyn_params_create(
     double asteroid_max_vel,
 
     vec vessel_pos, double vessel_base_length, double vessel_mass,
-    double vessel_max_vel, double vessel_max_ang_vel, double vessel_ang_acc,
-    double vessel_delta_ang_acc, double vessel_lin_acc,
-    double vessel_delta_lin_acc, int vessel_remaining_lifes,
-    double vessel_inv_time, double vessel_fire_cooldown_time,
+    double vessel_max_vel, double vessel_max_ang_vel,
+    double vessel_delta_ang_acc, double vessel_delta_lin_acc,
+    int vessel_remaining_lifes, double vessel_inv_time,
+    double vessel_fire_cooldown_time,
 
-    double bullet_vel, double bullet_max_distance, bool bullet_try_fire,
+    double bullet_vel, double bullet_max_distance,
 
     bool game_ended);
 
@@ -0,0 +1,118 @@
+#include "grid.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int max_cells_per_axis = 1024;
+
+static int grid_clamp_cells(int n) {
+    if (n < 1) {
+        return 1;
+    }
+    return n > max_cells_per_axis ? max_cells_per_axis : n;
+}
+
+grid grid_create(int nx, int ny, double x0, double x1, double y0, double y1) {
+    grid g;
+    g.nx = grid_clamp_cells(nx);
+    g.ny = grid_clamp_cells(ny);
+    g.x0 = x0;
+    g.x1 = x1;
+    g.y0 = y0;
+    g.y1 = y1;
+    g.cell_start = calloc((size_t)(g.nx * g.ny + 1), sizeof(int));
+    g.items = NULL;
+    g.num_items = 0;
+    g.capacity = 0;
+    return g;
+}
+
+grid grid_create_with_cell_size(double cell_size, double x0, double x1,
+                                double y0, double y1) {
+    int nx = (int)floor((x1 - x0) / cell_size);
+    int ny = (int)floor((y1 - y0) / cell_size);
+    return grid_create(nx, ny, x0, x1, y0, y1);
+}
+
+int grid_num_cells(const grid *g) { return g->nx * g->ny; }
+
+static int grid_wrap(int i, int n) {
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+static int grid_coord_x(const grid *g, double x) {
+    return (int)floor((x - g->x0) / (g->x1 - g->x0) * g->nx);
+}
+
+static int grid_coord_y(const grid *g, double y) {
+    return (int)floor((y - g->y0) / (g->y1 - g->y0) * g->ny);
+}
+
+int grid_cell_of(const grid *g, vec p) {
+    int ix = grid_wrap(grid_coord_x(g, p.x), g->nx);
+    int iy = grid_wrap(grid_coord_y(g, p.y), g->ny);
+    return iy * g->nx + ix;
+}
+
+void grid_build(grid *g, int num_items, grid_pos_fn pos, const void *ctx) {
+    int num_cells = grid_num_cells(g);
+    if (num_items > g->capacity) {
+        free(g->items);
+        g->capacity = num_items;
+        g->items = malloc((size_t)g->capacity * sizeof(int));
+    }
+    g->num_items = num_items;
+
+    int *cells = malloc((size_t)(num_items > 0 ? num_items : 1) * sizeof(int));
+    memset(g->cell_start, 0, (size_t)(num_cells + 1) * sizeof(int));
+    for (int i = 0; i < num_items; ++i) {
+        cells[i] = grid_cell_of(g, pos(ctx, i));
+        g->cell_start[cells[i] + 1] += 1;
+    }
+    for (int c = 0; c < num_cells; ++c) {
+        g->cell_start[c + 1] += g->cell_start[c];
+    }
+    int *next = malloc((size_t)num_cells * sizeof(int));
+    memcpy(next, g->cell_start, (size_t)num_cells * sizeof(int));
+    // each cell keeps its items in increasing order
+    for (int i = 0; i < num_items; ++i) {
+        g->items[next[cells[i]]++] = i;
+    }
+    free(next);
+    free(cells);
+}
+
+int grid_cells_in_rect(const grid *g, double x0, double x1, double y0,
+                       double y1, int *cells, int max_cells) {
+    int ix0 = grid_coord_x(g, x0);
+    int ix1 = grid_coord_x(g, x1);
+    int iy0 = grid_coord_y(g, y0);
+    int iy1 = grid_coord_y(g, y1);
+    if (ix1 - ix0 >= g->nx) {
+        ix0 = 0;
+        ix1 = g->nx - 1;
+    }
+    if (iy1 - iy0 >= g->ny) {
+        iy0 = 0;
+        iy1 = g->ny - 1;
+    }
+
+    int num_cells = 0;
+    for (int iy = iy0; iy <= iy1; ++iy) {
+        for (int ix = ix0; ix <= ix1 && num_cells < max_cells; ++ix) {
+            cells[num_cells++] =
+                grid_wrap(iy, g->ny) * g->nx + grid_wrap(ix, g->nx);
+        }
+    }
+    return num_cells;
+}
+
+void grid_free(grid *g) {
+    free(g->cell_start);
+    free(g->items);
+    g->cell_start = NULL;
+    g->items = NULL;
+    g->num_items = 0;
+    g->capacity = 0;
+}
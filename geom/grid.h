@@ -0,0 +1,40 @@
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#include "vec.h"
+#include <stdbool.h>
+
+// Uniform grid over the periodic box [x0, x1] x [y0, y1] holding item
+// indices, stored cell by cell (items of cell c are
+// items[cell_start[c]..cell_start[c + 1]]).
+typedef struct _grid {
+    int nx, ny;
+    double x0, x1, y0, y1;
+    int *cell_start;
+    int *items;
+    int num_items;
+    int capacity;
+} grid;
+
+typedef vec (*grid_pos_fn)(const void *ctx, int index);
+
+grid grid_create(int nx, int ny, double x0, double x1, double y0, double y1);
+
+// cells of about cell_size in the box, at least one per axis
+grid grid_create_with_cell_size(double cell_size, double x0, double x1,
+                                double y0, double y1);
+
+void grid_build(grid *g, int num_items, grid_pos_fn pos, const void *ctx);
+
+int grid_cell_of(const grid *g, vec p);
+
+// distinct cells overlapping [x0, x1] x [y0, y1], wrapped periodically,
+// returns their number (at most max_cells)
+int grid_cells_in_rect(const grid *g, double x0, double x1, double y0,
+                       double y1, int *cells, int max_cells);
+
+int grid_num_cells(const grid *g);
+
+void grid_free(grid *g);
+
+#endif
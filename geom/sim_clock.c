@@ -0,0 +1,31 @@
+#include "sim_clock.h"
+#include <math.h>
+
+// absorbs the rounding of seconds / dt for durations that are multiples of dt
+static const double tick_epsilon = 1.0e-9;
+
+sim_clock sim_clock_create(double dt) {
+    sim_clock clock;
+    clock.now = 0;
+    clock.dt = dt;
+    return clock;
+}
+
+void sim_clock_advance(sim_clock *clock) {
+    clock->now += 1;
+}
+
+sim_tick sim_clock_ticks(const sim_clock *clock, double seconds) {
+    if (seconds <= 0.0) {
+        return 0;
+    }
+    return (sim_tick)ceil(seconds / clock->dt - tick_epsilon);
+}
+
+sim_tick sim_clock_deadline(const sim_clock *clock, double seconds) {
+    return clock->now + sim_clock_ticks(clock, seconds);
+}
+
+bool sim_clock_reached(const sim_clock *clock, sim_tick deadline) {
+    return clock->now >= deadline;
+}
@@ -0,0 +1,30 @@
+#ifndef _SIM_CLOCK_H_
+#define _SIM_CLOCK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint64_t sim_tick;
+
+// Simulation time counted in ticks of dt seconds. Timers are deadlines in
+// ticks, so checking them is a compare that does not depend on how fast the
+// simulation runs compared to the wall clock.
+typedef struct _sim_clock {
+    sim_tick now; // ticks simulated so far
+    double dt;
+} sim_clock;
+
+sim_clock sim_clock_create(double dt);
+
+// called once at the end of each simulation tick
+void sim_clock_advance(sim_clock *clock);
+
+// number of ticks covering a duration in seconds (at least one if positive)
+sim_tick sim_clock_ticks(const sim_clock *clock, double seconds);
+
+// tick at which a duration starting now expires
+sim_tick sim_clock_deadline(const sim_clock *clock, double seconds);
+
+bool sim_clock_reached(const sim_clock *clock, sim_tick deadline);
+
+#endif
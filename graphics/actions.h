@@ -1,8 +1,6 @@
 #ifndef _ACTIONS_H_
 #define _ACTIONS_H_
 
-#include "../geom/dyn_params.h"
-
 typedef enum {
     exit_game,
     turn_left,
@@ -13,6 +11,7 @@ typedef enum {
     no_action
 } actions;
 
-void actions_params_from_action(dyn_params *params, actions act);
+// bit of an action in a bitmap of the actions held
+#define ACTION_BIT(act) (1u << (act))
 
 #endif
@@ -0,0 +1,195 @@
+#include "camera.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// cells of the visibility grid per side of the viewport
+static const int cells_per_view = 4;
+
+camera camera_create_default() {
+    camera cam = (camera){0};
+    cam.enabled = false;
+    cam.world_scale = 1.0;
+    for (int layer = 0; layer < camera_num_layers; ++layer) {
+        cam.visible[layer] = (camera_visible){0};
+    }
+    return cam;
+}
+
+bool camera_parse_arg(camera *cam, const char *arg) {
+    if (strncmp(arg, "--world-scale=", 14) == 0) {
+        cam->world_scale = atof(arg + 14);
+        if (cam->world_scale < 1.0) {
+            cam->world_scale = 1.0;
+        }
+        return true;
+    }
+    return false;
+}
+
+double camera_setup(camera *cam, dyn_params *params) {
+    cam->view_width = params->pos_max.x - params->pos_min.x;
+    cam->view_height = params->pos_max.y - params->pos_min.y;
+    cam->enabled = cam->world_scale > 1.0;
+    if (cam->enabled) {
+        params->pos_max.x = params->pos_min.x + cam->view_width *
+                                                    cam->world_scale;
+        params->pos_max.y = params->pos_min.y + cam->view_height *
+                                                    cam->world_scale;
+    }
+    cam->x0 = params->pos_min.x;
+    cam->x1 = params->pos_max.x;
+    cam->y0 = params->pos_min.y;
+    cam->y1 = params->pos_max.y;
+    cam->center = vec_create((cam->x0 + cam->x1) / 2.0,
+                             (cam->y0 + cam->y1) / 2.0);
+    if (!cam->enabled) {
+        return 1.0;
+    }
+
+    double cell_size = fmin(cam->view_width, cam->view_height) / cells_per_view;
+    for (int layer = 0; layer < camera_num_layers; ++layer) {
+        grid_free(&cam->visible[layer].cells);
+        cam->visible[layer].cells = grid_create_with_cell_size(
+            cell_size, cam->x0, cam->x1, cam->y0, cam->y1);
+    }
+    return cam->world_scale * cam->world_scale;
+}
+
+void camera_follow(camera *cam, vec target) {
+    if (cam->enabled) {
+        cam->center = target;
+    }
+}
+
+void camera_view(const camera *cam, double *x0, double *x1, double *y0,
+                 double *y1) {
+    if (!cam->enabled) {
+        *x0 = cam->x0;
+        *x1 = cam->x1;
+        *y0 = cam->y0;
+        *y1 = cam->y1;
+        return;
+    }
+    *x0 = cam->center.x - cam->view_width / 2.0;
+    *x1 = cam->center.x + cam->view_width / 2.0;
+    *y0 = cam->center.y - cam->view_height / 2.0;
+    *y1 = cam->center.y + cam->view_height / 2.0;
+}
+
+static double camera_nearest(double d, double period) {
+    return d - period * floor(d / period + 0.5);
+}
+
+vec camera_image(const camera *cam, vec pos) {
+    if (!cam->enabled) {
+        return pos;
+    }
+    return vec_create(
+        cam->center.x + camera_nearest(pos.x - cam->center.x, cam->x1 - cam->x0),
+        cam->center.y +
+            camera_nearest(pos.y - cam->center.y, cam->y1 - cam->y0));
+}
+
+static bool camera_reserve(void ***array, int length) {
+    void **grown = realloc(*array, (size_t)length * sizeof(void *));
+    if (grown == NULL) {
+        return false;
+    }
+    *array = grown;
+    return true;
+}
+
+static vec camera_grid_pos(const void *ctx, int index) {
+    const camera_visible *visible = ctx;
+    return visible->pos(visible->all[index]);
+}
+
+const camera_visible *camera_cull(camera *cam, camera_layer layer,
+                                  vector *items, camera_pos_fn pos,
+                                  double margin) {
+    camera_visible *visible = &cam->visible[layer];
+    int num_items = vector_length(items);
+    visible->length = 0;
+    if (num_items > visible->capacity) {
+        if (!camera_reserve(&visible->all, num_items) ||
+            !camera_reserve(&visible->items, num_items)) {
+            return visible;
+        }
+        visible->capacity = num_items;
+    }
+    for (int i = 0; i < num_items; ++i) {
+        visible->all[i] = vector_get(items, i);
+    }
+    visible->pos = pos;
+    cam->total += (unsigned long)num_items;
+    if (layer == camera_asteroids) {
+        cam->frames += 1;
+    }
+    if (!cam->enabled) {
+        if (num_items > 0) {
+            memcpy(visible->items, visible->all,
+                   (size_t)num_items * sizeof(void *));
+        }
+        visible->length = num_items;
+        cam->considered += (unsigned long)num_items;
+        cam->drawn += (unsigned long)num_items;
+        return visible;
+    }
+
+    grid *cells = &visible->cells;
+    grid_build(cells, num_items, camera_grid_pos, visible);
+    int max_cells = grid_num_cells(cells);
+    if (max_cells > visible->query_capacity) {
+        int *query = realloc(visible->query, (size_t)max_cells * sizeof(int));
+        if (query == NULL) {
+            return visible;
+        }
+        visible->query = query;
+        visible->query_capacity = max_cells;
+    }
+    double half_width = cam->view_width / 2.0 + margin;
+    double half_height = cam->view_height / 2.0 + margin;
+    int num_cells = grid_cells_in_rect(
+        cells, cam->center.x - half_width, cam->center.x + half_width,
+        cam->center.y - half_height, cam->center.y + half_height,
+        visible->query, max_cells);
+    for (int c = 0; c < num_cells; ++c) {
+        int first = cells->cell_start[visible->query[c]];
+        int end = cells->cell_start[visible->query[c] + 1];
+        for (int k = first; k < end; ++k) {
+            void *item = visible->all[cells->items[k]];
+            vec image = camera_image(cam, pos(item));
+            if (fabs(image.x - cam->center.x) <= half_width &&
+                fabs(image.y - cam->center.y) <= half_height) {
+                visible->items[visible->length++] = item;
+            }
+        }
+        cam->considered += (unsigned long)(end - first);
+    }
+    cam->drawn += (unsigned long)visible->length;
+    return visible;
+}
+
+void camera_print(const camera *cam, FILE *out) {
+    if (!cam->enabled || cam->frames == 0) {
+        return;
+    }
+    fprintf(out,
+            "camera: world %gx the viewport, per frame %.1f items drawn, %.1f "
+            "looked at, %.1f in the world\n",
+            cam->world_scale, (double)cam->drawn / (double)cam->frames,
+            (double)cam->considered / (double)cam->frames,
+            (double)cam->total / (double)cam->frames);
+}
+
+void camera_free(camera *cam) {
+    for (int layer = 0; layer < camera_num_layers; ++layer) {
+        camera_visible *visible = &cam->visible[layer];
+        free(visible->items);
+        free(visible->all);
+        free(visible->query);
+        grid_free(&visible->cells);
+        *visible = (camera_visible){0};
+    }
+}
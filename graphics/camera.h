@@ -0,0 +1,82 @@
+#ifndef _CAMERA_H_
+#define _CAMERA_H_
+
+#include "../c_vector/vector.h"
+#include "../geom/dyn_params.h"
+#include "../geom/grid.h"
+#include "../geom/vec.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// position in the world of an item of the vectors culled
+typedef vec (*camera_pos_fn)(const void *item);
+
+// Items of a vector seen by the camera in the frame being drawn.
+typedef struct _camera_visible {
+    void **items;
+    int length;
+    void **all; // every item of the vector, in order
+    int capacity;
+    camera_pos_fn pos;
+    grid cells; // of all, for the visibility query
+    int *query; // cells overlapping the viewport
+    int query_capacity;
+} camera_visible;
+
+typedef enum {
+    camera_asteroids,
+    camera_bullets,
+    camera_num_layers,
+} camera_layer;
+
+// Viewport of a fixed size following a point of the periodic world
+// [x0, x1] x [y0, y1]. The entities are drawn at their periodic image
+// nearest to the center of the viewport. When the world is not larger than
+// the viewport, the camera is disabled and the frame shows the whole world.
+typedef struct _camera {
+    bool enabled;
+    double world_scale; // side of the world over the side of the viewport
+    double view_width;  // part of the world shown, in world units
+    double view_height;
+    double x0; // world
+    double x1;
+    double y0;
+    double y1;
+    vec center;
+    camera_visible visible[camera_num_layers];
+    unsigned long frames;
+    unsigned long considered; // items the query returned, over all frames
+    unsigned long drawn;      // items in the viewport, over all frames
+    unsigned long total;      // items in the world, over all frames
+} camera;
+
+camera camera_create_default();
+
+// handles --world-scale=<k>, returns false if arg is not for the camera
+bool camera_parse_arg(camera *cam, const char *arg);
+
+// makes the world of params world_scale times larger per side, the
+// viewport keeping the size of the original world. Returns the factor
+// the population has to grow by to keep the same density.
+double camera_setup(camera *cam, dyn_params *params);
+
+void camera_follow(camera *cam, vec target);
+
+// part of the world the frame shows
+void camera_view(const camera *cam, double *x0, double *x1, double *y0,
+                 double *y1);
+
+// periodic image of pos nearest to the center of the viewport
+vec camera_image(const camera *cam, vec pos);
+
+// the items of the vector that may be seen, margin being the largest
+// distance from its position an item is drawn at
+const camera_visible *camera_cull(camera *cam, camera_layer layer,
+                                  vector *items, camera_pos_fn pos,
+                                  double margin);
+
+void camera_print(const camera *cam, FILE *out);
+
+void camera_free(camera *cam);
+
+#endif
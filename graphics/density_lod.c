@@ -0,0 +1,208 @@
+#include "density_lod.h"
+#include "../geom/utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int default_tile_size = 16;
+static const int default_threshold = 16;
+// entities a part has to count for its histogram to be worth summing
+static const int min_items_per_part = 4096;
+// a tile holding threshold << max_level entities is at full brightness
+static const int max_level = 6;
+static const int min_shade = 96;
+
+typedef struct density_lod_task {
+    density_lod *lod;
+    void *const *items;
+    density_lod_pos_fn pos;
+    const void *ctx;
+    int offset;
+    int length;
+} density_lod_task;
+
+static int wrap(int i, int n) {
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+static bool density_lod_reserve(int **array, int *capacity, size_t length) {
+    if (length <= (size_t)*capacity) {
+        return true;
+    }
+    int *grown = realloc(*array, length * sizeof(int));
+    if (grown == NULL) {
+        return false;
+    }
+    *array = grown;
+    *capacity = (int)length;
+    return true;
+}
+
+density_lod density_lod_create_default() {
+    density_lod lod = (density_lod){0};
+    lod.tile_size = default_tile_size;
+    lod.threshold = default_threshold;
+    lod.active = false;
+    lod.num_parts = 1;
+    density_lod_set_pool(&lod, NULL);
+    return lod;
+}
+
+bool density_lod_parse_arg(density_lod *lod, const char *arg) {
+    if (strncmp(arg, "--lod-threshold=", 16) == 0) {
+        lod->threshold = atoi(arg + 16);
+        return true;
+    }
+    if (strncmp(arg, "--lod-tile=", 11) == 0) {
+        int tile_size = atoi(arg + 11);
+        lod->tile_size = tile_size < 1 ? default_tile_size : tile_size;
+        return true;
+    }
+    return false;
+}
+
+void density_lod_set_pool(density_lod *lod, worker_pool *pool) {
+    lod->pool = pool;
+    lod->count_stage = stage_policy_create("density", pool);
+    // each item is a part of the entities, already a lot of work
+    lod->count_stage.inline_threshold = 2;
+    lod->count_stage.chunk = 1;
+}
+
+bool density_lod_begin(density_lod *lod, struct gfx_context_t *ctxt,
+                       int num_items, double x0, double x1, double y0,
+                       double y1) {
+    lod->active = false;
+    lod->num_items = 0;
+    lod->frames += 1;
+    if (lod->threshold <= 0 || num_items <= lod->threshold) {
+        return false;
+    }
+
+    lod->width = ctxt->width;
+    lod->height = ctxt->height;
+    lod->x0 = x0;
+    lod->x1 = x1;
+    lod->y0 = y0;
+    lod->y1 = y1;
+    lod->tiles_x = (lod->width + lod->tile_size - 1) / lod->tile_size;
+    lod->tiles_y = (lod->height + lod->tile_size - 1) / lod->tile_size;
+    lod->num_parts = num_items / min_items_per_part;
+    if (lod->num_parts > lod->count_stage.max_workers) {
+        lod->num_parts = lod->count_stage.max_workers;
+    }
+    if (lod->num_parts < 1) {
+        lod->num_parts = 1;
+    }
+
+    size_t num_tiles = (size_t)lod->tiles_x * (size_t)lod->tiles_y;
+    if (!density_lod_reserve(&lod->counts, &lod->counts_capacity,
+                             num_tiles) ||
+        !density_lod_reserve(&lod->partial, &lod->partial_capacity,
+                             num_tiles * (size_t)lod->num_parts) ||
+        !density_lod_reserve(&lod->tile_of, &lod->items_capacity,
+                             (size_t)num_items)) {
+        return false;
+    }
+    memset(lod->partial, 0, num_tiles * (size_t)lod->num_parts * sizeof(int));
+    lod->active = true;
+    return true;
+}
+
+static void density_lod_count(void *ctx, int begin, int end) {
+    density_lod_task *task = ctx;
+    density_lod *lod = task->lod;
+    size_t num_tiles = (size_t)lod->tiles_x * (size_t)lod->tiles_y;
+    for (int part = begin; part < end; ++part) {
+        int *histogram = lod->partial + (size_t)part * num_tiles;
+        int first = (int)((long)task->length * part / lod->num_parts);
+        int last = (int)((long)task->length * (part + 1) / lod->num_parts);
+        for (int i = first; i < last; ++i) {
+            vec pos = task->pos(task->ctx, task->items[i]);
+            int x = wrap((int)rescale_to_window(0, lod->width, lod->x0,
+                                                lod->x1, pos.x),
+                         lod->width);
+            int y = wrap((int)rescale_to_window(0, lod->height, lod->y0,
+                                                lod->y1, pos.y),
+                         lod->height);
+            int tile = y / lod->tile_size * lod->tiles_x + x / lod->tile_size;
+            histogram[tile] += 1;
+            lod->tile_of[task->offset + i] = tile;
+        }
+    }
+}
+
+int density_lod_add(density_lod *lod, void *const *items, int length,
+                    density_lod_pos_fn pos, const void *ctx) {
+    int offset = lod->num_items;
+    if (!lod->active || offset + length > lod->items_capacity) {
+        return offset;
+    }
+    density_lod_task task = {lod, items, pos, ctx, offset, length};
+    stage_policy_run(&lod->count_stage, lod->pool, lod->num_parts,
+                     density_lod_count, &task);
+    lod->num_items += length;
+    return offset;
+}
+
+void density_lod_end(density_lod *lod, struct gfx_context_t *ctxt) {
+    if (!lod->active) {
+        return;
+    }
+    int num_tiles = lod->tiles_x * lod->tiles_y;
+    int dense_tiles = 0;
+    for (int tile = 0; tile < num_tiles; ++tile) {
+        int count = 0;
+        for (int part = 0; part < lod->num_parts; ++part) {
+            count +=
+                lod->partial[(size_t)part * (size_t)num_tiles + (size_t)tile];
+        }
+        lod->counts[tile] = count;
+        if (count <= lod->threshold) {
+            continue;
+        }
+
+        dense_tiles += 1;
+        double level = log2((double)count / lod->threshold) / max_level;
+        int shade = min_shade + (int)((255 - min_shade) * fmin(level, 1.0));
+        int x = tile % lod->tiles_x * lod->tile_size;
+        int y = tile / lod->tiles_x * lod->tile_size;
+        gfx_fill_rect(ctxt, x, y, lod->tile_size, lod->tile_size,
+                      MAKE_COLOR(shade, shade, shade));
+    }
+    lod->dense_tiles += (unsigned long)dense_tiles;
+    if (dense_tiles > 0) {
+        lod->aggregated_frames += 1;
+    }
+}
+
+bool density_lod_is_sparse(const density_lod *lod, int index) {
+    return !lod->active || index >= lod->num_items ||
+           lod->counts[lod->tile_of[index]] <= lod->threshold;
+}
+
+void density_lod_print(const density_lod *lod, FILE *out) {
+    if (lod->threshold <= 0) {
+        return;
+    }
+    fprintf(out,
+            "level of detail: %lu frames aggregated out of %lu, %.1f dense "
+            "tiles per frame\n",
+            lod->aggregated_frames, lod->frames,
+            lod->aggregated_frames > 0
+                ? (double)lod->dense_tiles / (double)lod->aggregated_frames
+                : 0.0);
+}
+
+void density_lod_free(density_lod *lod) {
+    free(lod->counts);
+    free(lod->partial);
+    free(lod->tile_of);
+    lod->counts = NULL;
+    lod->partial = NULL;
+    lod->tile_of = NULL;
+    lod->counts_capacity = 0;
+    lod->partial_capacity = 0;
+    lod->items_capacity = 0;
+}
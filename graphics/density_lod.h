@@ -0,0 +1,77 @@
+#ifndef _DENSITY_LOD_H_
+#define _DENSITY_LOD_H_
+
+#include "../geom/vec.h"
+#include "../threads/stage_policy.h"
+#include "../threads/worker_pool.h"
+#include "gfx.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// position in the world shown of an item counted
+typedef vec (*density_lod_pos_fn)(const void *ctx, const void *item);
+
+// Level of detail for crowded frames: the entities are counted per square
+// tile of the frame, and the tiles holding more than threshold of them are
+// drawn as one block whose brightness follows the count, instead of
+// drawing each entity. The counts go to one histogram per part of the
+// entities, filled in parallel, then summed.
+typedef struct _density_lod {
+    int tile_size; // pixels per side of a tile
+    int threshold; // entities in a tile above which it is aggregated, 0 to
+                   // always draw the entities
+    bool active;   // for the frame being drawn
+    int width;     // of the frame being drawn
+    int height;
+    double x0; // part of the world shown by the frame
+    double x1;
+    double y0;
+    double y1;
+    int tiles_x;
+    int tiles_y;
+    int num_parts;
+    int *counts;  // entities per tile
+    int *partial; // counts of each part, num_parts histograms
+    int counts_capacity;
+    int partial_capacity;
+    int *tile_of; // tile of each entity added this frame
+    int num_items;
+    int items_capacity;
+    worker_pool *pool;
+    stage_policy count_stage;
+    unsigned long frames;
+    unsigned long aggregated_frames;
+    unsigned long dense_tiles;
+} density_lod;
+
+density_lod density_lod_create_default();
+
+// handles --lod-threshold=<n> and --lod-tile=<pixels>, returns false if arg
+// is not for the level of detail
+bool density_lod_parse_arg(density_lod *lod, const char *arg);
+
+// pool may be NULL to count on the caller only
+void density_lod_set_pool(density_lod *lod, worker_pool *pool);
+
+// starts a frame of the given context showing [x0, x1] x [y0, y1] with
+// num_items entities at most, returns false if none of its tiles can get
+// dense enough to be aggregated
+bool density_lod_begin(density_lod *lod, struct gfx_context_t *ctxt,
+                       int num_items, double x0, double x1, double y0,
+                       double y1);
+
+// counts length items, the i-th of them gets the index returned + i
+int density_lod_add(density_lod *lod, void *const *items, int length,
+                    density_lod_pos_fn pos, const void *ctx);
+
+// sums the histograms and draws the dense tiles
+void density_lod_end(density_lod *lod, struct gfx_context_t *ctxt);
+
+// true if the entity of that index has to be drawn on its own
+bool density_lod_is_sparse(const density_lod *lod, int index);
+
+void density_lod_print(const density_lod *lod, FILE *out);
+
+void density_lod_free(density_lod *lod);
+
+#endif
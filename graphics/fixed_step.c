@@ -0,0 +1,92 @@
+#include "fixed_step.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int default_max_ticks = 5;
+
+fixed_step fixed_step_create_default() {
+    fixed_step fs = (fixed_step){0};
+    fs.tick_rate = 0.0;
+    fs.dt = 0.0;
+    fs.max_ticks = default_max_ticks;
+    fs.lockstep = false;
+    fs.accumulator = 0.0;
+    clock_gettime(CLOCK_MONOTONIC, &fs.last);
+    return fs;
+}
+
+bool fixed_step_parse_arg(fixed_step *fs, const char *arg) {
+    if (strncmp(arg, "--tick-rate=", 12) == 0) {
+        fs->tick_rate = atof(arg + 12);
+        return true;
+    }
+    if (strncmp(arg, "--max-ticks-per-frame=", 22) == 0) {
+        fs->max_ticks = atoi(arg + 22);
+        if (fs->max_ticks < 1) {
+            fs->max_ticks = 1;
+        }
+        return true;
+    }
+    if (strcmp(arg, "--lockstep") == 0) {
+        fs->lockstep = true;
+        return true;
+    }
+    return false;
+}
+
+void fixed_step_setup(fixed_step *fs, dyn_params *params) {
+    if (fs->tick_rate > 0.0) {
+        params->dt = 1.0 / fs->tick_rate;
+        params->clock = sim_clock_create(params->dt);
+    }
+    fs->dt = params->dt;
+    fs->tick_rate = 1.0 / fs->dt;
+}
+
+void fixed_step_start(fixed_step *fs) {
+    clock_gettime(CLOCK_MONOTONIC, &fs->last);
+    fs->accumulator = 0.0;
+}
+
+int fixed_step_advance(fixed_step *fs) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (double)(now.tv_sec - fs->last.tv_sec);
+    elapsed += (double)(now.tv_nsec - fs->last.tv_nsec) / 1000000000.0;
+    fs->last = now;
+    fs->frames += 1;
+    if (fs->lockstep) {
+        fs->ticks += 1;
+        return 1;
+    }
+
+    fs->accumulator += elapsed;
+    int ticks = (int)floor(fs->accumulator / fs->dt);
+    fs->accumulator -= ticks * fs->dt;
+    if (ticks > fs->max_ticks) {
+        // too late to catch up: the simulation slows down instead of
+        // spending ever longer frames on it
+        fs->dropped_time += (ticks - fs->max_ticks) * fs->dt;
+        fs->capped_frames += 1;
+        ticks = fs->max_ticks;
+    }
+    fs->ticks += (unsigned long)ticks;
+    return ticks;
+}
+
+double fixed_step_alpha(const fixed_step *fs) {
+    if (fs->lockstep) {
+        return 1.0;
+    }
+    double alpha = fs->accumulator / fs->dt;
+    return alpha > 1.0 ? 1.0 : alpha;
+}
+
+void fixed_step_print(const fixed_step *fs, FILE *out) {
+    fprintf(out,
+            "ticks: %lu at %.1f Hz over %lu frames, capped frames: %lu, "
+            "dropped: %.2f s\n",
+            fs->ticks, fs->tick_rate, fs->frames, fs->capped_frames,
+            fs->dropped_time);
+}
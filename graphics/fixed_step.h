@@ -0,0 +1,45 @@
+#ifndef _FIXED_STEP_H_
+#define _FIXED_STEP_H_
+
+#include "../geom/dyn_params.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+// Runs the simulation at a fixed tick rate whatever the frame rate: the
+// real time elapsed is accumulated and consumed by whole ticks, and the
+// frame shows the state interpolated between the last two ticks.
+typedef struct _fixed_step {
+    double tick_rate; // ticks per second, 0 to keep the dt of the simulation
+    double dt;        // seconds of simulation per tick
+    int max_ticks;    // ticks per frame at most, the lag beyond is dropped
+    bool lockstep;    // one tick per frame, whatever the time elapsed
+    double accumulator; // real time not simulated yet
+    struct timespec last;
+    unsigned long frames;
+    unsigned long ticks;
+    unsigned long capped_frames;
+    double dropped_time;
+} fixed_step;
+
+fixed_step fixed_step_create_default();
+
+// handles --tick-rate=<hz>, --max-ticks-per-frame=<n> and --lockstep,
+// returns false if arg is not for the time step
+bool fixed_step_parse_arg(fixed_step *fs, const char *arg);
+
+// sets the dt of the simulation from the tick rate, or the other way around
+void fixed_step_setup(fixed_step *fs, dyn_params *params);
+
+// starts the clock, right before the first frame
+void fixed_step_start(fixed_step *fs);
+
+// ticks to simulate before drawing the frame
+int fixed_step_advance(fixed_step *fs);
+
+// fraction of a tick the state shown is past the previous tick, in [0, 1]
+double fixed_step_alpha(const fixed_step *fs);
+
+void fixed_step_print(const fixed_step *fs, FILE *out);
+
+#endif
@@ -0,0 +1,98 @@
+#include "frame_budget.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int escalate_after = 3;
+static const int relax_after = 60;
+static const double relax_ratio = 0.6;
+
+frame_budget frame_budget_create(double budget) {
+    frame_budget fb = (frame_budget){0};
+    fb.budget = budget;
+    fb.level = 0;
+    fb.escalate_after = escalate_after;
+    fb.relax_after = relax_after;
+    fb.render_skipped = false;
+    clock_gettime(CLOCK_MONOTONIC, &fb.frame_start);
+    return fb;
+}
+
+bool frame_budget_parse_arg(frame_budget *fb, const char *arg) {
+    if (strncmp(arg, "--frame-budget-ms=", 18) == 0) {
+        fb->budget = atof(arg + 18) / 1000.0;
+        return true;
+    }
+    return false;
+}
+
+void frame_budget_start(frame_budget *fb) {
+    clock_gettime(CLOCK_MONOTONIC, &fb->frame_start);
+}
+
+void frame_budget_finish(frame_budget *fb) {
+    struct timespec finish_time;
+    clock_gettime(CLOCK_MONOTONIC, &finish_time);
+
+    double elapsed = (double)(finish_time.tv_sec - fb->frame_start.tv_sec);
+    elapsed += (double)(finish_time.tv_nsec - fb->frame_start.tv_nsec) / 1000000000.0;
+    fb->last_frame_time = elapsed;
+    fb->frames += 1;
+    if (fb->budget <= 0.0) {
+        return;
+    }
+
+    if (elapsed > fb->budget) {
+        fb->overloaded_frames += 1;
+        fb->over_streak += 1;
+        fb->under_streak = 0;
+    } else if (elapsed < relax_ratio * fb->budget) {
+        fb->under_streak += 1;
+        fb->over_streak = 0;
+    } else {
+        fb->over_streak = 0;
+        fb->under_streak = 0;
+    }
+
+    if (fb->over_streak >= fb->escalate_after &&
+        fb->level < degrade_num_levels - 1) {
+        fb->level += 1;
+        fb->over_streak = 0;
+    } else if (fb->under_streak >= fb->relax_after && fb->level > 0) {
+        fb->level -= 1;
+        fb->under_streak = 0;
+    }
+}
+
+bool frame_budget_reuse_far_forces(frame_budget *fb) {
+    if (fb->level < degrade_far_forces) {
+        return false;
+    }
+    fb->fired[degrade_far_forces] += 1;
+    return true;
+}
+
+bool frame_budget_skip_render(frame_budget *fb) {
+    if (fb->level < degrade_skip_render || fb->render_skipped) {
+        fb->render_skipped = false;
+        return false;
+    }
+    fb->fired[degrade_skip_render] += 1;
+    fb->render_skipped = true;
+    return true;
+}
+
+int frame_budget_resolution_divisor(frame_budget *fb) {
+    if (fb->level < degrade_low_resolution) {
+        return 1;
+    }
+    fb->fired[degrade_low_resolution] += 1;
+    return 2;
+}
+
+void frame_budget_print(const frame_budget *fb, FILE *out) {
+    fprintf(out,
+            "frames: %lu, over budget: %lu, far forces reused: %lu, renders "
+            "skipped: %lu, low resolution: %lu\n",
+            fb->frames, fb->overloaded_frames, fb->fired[degrade_far_forces],
+            fb->fired[degrade_skip_render], fb->fired[degrade_low_resolution]);
+}
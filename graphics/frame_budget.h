@@ -0,0 +1,54 @@
+#ifndef _FRAME_BUDGET_H_
+#define _FRAME_BUDGET_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+// Degradation steps, in the order they are enabled when frames keep running
+// over budget. A step stays enabled while a later one is.
+typedef enum {
+    degrade_far_forces = 1, // reuse last computed forces for far pairs
+    degrade_skip_render,    // skip one frame in two
+    degrade_low_resolution, // render at half resolution
+    degrade_num_levels
+} degrade_step;
+
+typedef struct _frame_budget {
+    double budget; // seconds, 0 disables the degradation
+    int level;     // all steps <= level are enabled
+    int over_streak;
+    int under_streak;
+    int escalate_after; // frames over budget before enabling the next step
+    int relax_after;    // frames well under budget before disabling one
+    bool render_skipped;
+    struct timespec frame_start;
+    double last_frame_time;
+    unsigned long frames;
+    unsigned long overloaded_frames;
+    unsigned long fired[degrade_num_levels]; // frames each step was applied
+} frame_budget;
+
+frame_budget frame_budget_create(double budget);
+
+// handles --frame-budget-ms=<ms>, returns false if arg is not for the budget
+bool frame_budget_parse_arg(frame_budget *fb, const char *arg);
+
+void frame_budget_start(frame_budget *fb);
+
+// measures the frame and moves to the next or previous step if needed, to be
+// called before the frame is presented so that waiting for the display is
+// not counted
+void frame_budget_finish(frame_budget *fb);
+
+bool frame_budget_reuse_far_forces(frame_budget *fb);
+
+// never true twice in a row, so that input keeps reaching the display
+bool frame_budget_skip_render(frame_budget *fb);
+
+// 1 for the full resolution, 2 for half of it
+int frame_budget_resolution_divisor(frame_budget *fb);
+
+void frame_budget_print(const frame_budget *fb, FILE *out);
+
+#endif
@@ -0,0 +1,153 @@
+#include "frame_dump.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int y4m_frame_rate = 30;
+
+// true if path holds a single %d conversion, with an optional width
+static bool frame_dump_numbered(const char *path) {
+    const char *conversion = strchr(path, '%');
+    if (conversion == NULL) {
+        return false;
+    }
+    const char *c = conversion + 1;
+    while (*c >= '0' && *c <= '9') {
+        c += 1;
+    }
+    return *c == 'd' && strchr(c, '%') == NULL;
+}
+
+static FILE *frame_dump_open_file(frame_dump *dump) {
+    if (dump->path[0] == '|') {
+        // a command exiting early must not kill the game
+        signal(SIGPIPE, SIG_IGN);
+        dump->pipe = true;
+        return popen(dump->path + 1, "w");
+    }
+    if (dump->format == frame_dump_ppm && frame_dump_numbered(dump->path)) {
+        size_t length = strlen(dump->path) + 32;
+        char *name = malloc(length);
+        if (name == NULL) {
+            return NULL;
+        }
+        snprintf(name, length, dump->path, (int)dump->frames);
+        FILE *file = fopen(name, "wb");
+        free(name);
+        return file;
+    }
+    return fopen(dump->path, "wb");
+}
+
+frame_dump *frame_dump_open(frame_dump_format format, const char *path,
+                            int width, int height) {
+    frame_dump *dump = calloc(1, sizeof(frame_dump));
+    if (dump == NULL) {
+        return NULL;
+    }
+    dump->format = format;
+    dump->width = width;
+    dump->height = height;
+    dump->path = malloc(strlen(path) + 1);
+    dump->planes = malloc((size_t)width * (size_t)height * 3);
+    if (dump->path == NULL || dump->planes == NULL) {
+        frame_dump_close(dump);
+        return NULL;
+    }
+    strcpy(dump->path, path);
+    dump->file = frame_dump_open_file(dump);
+    if (dump->file == NULL) {
+        fprintf(stderr, "Cannot write the frames to %s\n", path);
+        frame_dump_close(dump);
+        return NULL;
+    }
+    if (format == frame_dump_y4m) {
+        fprintf(dump->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width,
+                height, y4m_frame_rate);
+    }
+    return dump;
+}
+
+// BT.601 studio range, the conversion of the usual video tools
+static void frame_dump_yuv(uint32_t color, uint8_t *y, uint8_t *u,
+                           uint8_t *v) {
+    int r = (color >> 16) & 0xff;
+    int g = (color >> 8) & 0xff;
+    int b = color & 0xff;
+    *y = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    *u = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    *v = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// converts the frame scaled to the size of the dump, to nearest pixels
+static void frame_dump_convert(frame_dump *dump, const uint32_t *pixels,
+                               int stride, int width, int height) {
+    size_t plane_size = (size_t)dump->width * (size_t)dump->height;
+    uint8_t *out = dump->planes;
+    for (int row = 0; row < dump->height; ++row) {
+        const uint32_t *src =
+            pixels + (size_t)(row * height / dump->height) * (size_t)stride;
+        for (int col = 0; col < dump->width; ++col) {
+            uint32_t color = src[col * width / dump->width];
+            if (dump->format == frame_dump_y4m) {
+                size_t i = (size_t)row * (size_t)dump->width + (size_t)col;
+                frame_dump_yuv(color, &out[i], &out[plane_size + i],
+                               &out[2 * plane_size + i]);
+            } else {
+                uint8_t *rgb =
+                    &out[((size_t)row * (size_t)dump->width + (size_t)col) * 3];
+                rgb[0] = (color >> 16) & 0xff;
+                rgb[1] = (color >> 8) & 0xff;
+                rgb[2] = color & 0xff;
+            }
+        }
+    }
+}
+
+bool frame_dump_write(frame_dump *dump, const uint32_t *pixels, int stride,
+                      int width, int height) {
+    if (dump->failed) {
+        return false;
+    }
+    if (dump->file == NULL) {
+        dump->file = frame_dump_open_file(dump);
+    }
+    frame_dump_convert(dump, pixels, stride, width, height);
+
+    size_t size = (size_t)dump->width * (size_t)dump->height * 3;
+    bool written = dump->file != NULL;
+    if (written && dump->format == frame_dump_y4m) {
+        written = fputs("FRAME\n", dump->file) >= 0;
+    } else if (written && dump->format == frame_dump_ppm) {
+        written = fprintf(dump->file, "P6\n%d %d\n255\n", dump->width,
+                          dump->height) > 0;
+    }
+    written = written && fwrite(dump->planes, 1, size, dump->file) == size;
+    if (written && dump->format == frame_dump_ppm &&
+        frame_dump_numbered(dump->path)) {
+        written = fclose(dump->file) == 0;
+        dump->file = NULL;
+    }
+    dump->frames += 1;
+    if (!written) {
+        fprintf(stderr, "Writing frame %lu to %s failed, no more frames are "
+                        "written\n",
+                dump->frames - 1, dump->path);
+        dump->failed = true;
+    }
+    return written;
+}
+
+void frame_dump_close(frame_dump *dump) {
+    if (dump == NULL) {
+        return;
+    }
+    if (dump->file != NULL && dump->pipe) {
+        pclose(dump->file);
+    } else if (dump->file != NULL) {
+        fclose(dump->file);
+    }
+    free(dump->planes);
+    free(dump->path);
+    free(dump);
+}
@@ -0,0 +1,40 @@
+#ifndef _FRAME_DUMP_H_
+#define _FRAME_DUMP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    frame_dump_raw, // RGB24 frames back to back, no header
+    frame_dump_y4m, // YUV4MPEG2 stream, 4:4:4
+    frame_dump_ppm, // binary PPM images, one file per frame if the path has a
+                    // printf conversion for the frame number
+} frame_dump_format;
+
+// Writes the frames of a graphic context to a file or to the input of a
+// command, at a fixed size: frames drawn smaller are scaled up to it the
+// way the window would show them.
+typedef struct frame_dump {
+    frame_dump_format format;
+    char *path;
+    FILE *file; // NULL between the files of numbered PPM snapshots
+    bool pipe;  // file was opened with popen
+    bool failed;
+    int width;
+    int height;
+    uint8_t *planes; // a frame converted to the format written
+    unsigned long frames;
+} frame_dump;
+
+// the path may be "|command" to write to the input of a shell command
+frame_dump *frame_dump_open(frame_dump_format format, const char *path,
+                            int width, int height);
+
+// false once writing failed, the next frames are not written anymore
+bool frame_dump_write(frame_dump *dump, const uint32_t *pixels, int stride,
+                      int width, int height);
+
+void frame_dump_close(frame_dump *dump);
+
+#endif
@@ -0,0 +1,153 @@
+#include "frame_pacer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const double default_fps = 60.0;
+static const double default_idle_fps = 10.0;
+// a sleep usually wakes up within this, the rest of the wait is spun
+static const double default_spin_time = 0.001;
+
+static double frame_pacer_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+static double frame_pacer_cpu_time() {
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+static const char *frame_pacer_mode_name(pace_mode mode) {
+    switch (mode) {
+    case pace_vsync:
+        return "vsync";
+    case pace_target_fps:
+        return "target fps";
+    default:
+        return "unbounded";
+    }
+}
+
+frame_pacer frame_pacer_create_default() {
+    frame_pacer fp = (frame_pacer){0};
+    fp.mode = pace_vsync;
+    fp.target_fps = default_fps;
+    fp.idle_fps = default_idle_fps;
+    fp.refresh_rate = default_fps;
+    fp.spin_time = default_spin_time;
+    return fp;
+}
+
+bool frame_pacer_parse_arg(frame_pacer *fp, const char *arg) {
+    if (strcmp(arg, "--vsync") == 0) {
+        fp->mode = pace_vsync;
+    } else if (strcmp(arg, "--unbounded") == 0) {
+        fp->mode = pace_unbounded;
+    } else if (strncmp(arg, "--fps=", 6) == 0) {
+        fp->target_fps = atof(arg + 6);
+        fp->mode = fp->target_fps > 0.0 ? pace_target_fps : pace_unbounded;
+    } else if (strncmp(arg, "--idle-fps=", 11) == 0) {
+        fp->idle_fps = atof(arg + 11);
+        if (fp->idle_fps < 0.0) {
+            fp->idle_fps = 0.0;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void frame_pacer_setup(frame_pacer *fp, struct gfx_context_t *ctxt) {
+    if (ctxt->headless) {
+        // nothing to show, the frames are only limited by the simulation
+        fp->mode = pace_unbounded;
+        fp->idle_fps = 0.0;
+        return;
+    }
+    double refresh_rate = gfx_refresh_rate(ctxt);
+    if (refresh_rate > 0.0) {
+        fp->refresh_rate = refresh_rate;
+    }
+    if (fp->mode == pace_vsync && !gfx_set_vsync(ctxt, true)) {
+        fprintf(stderr, "No vsync, pacing at %.0f frames per second\n",
+                fp->refresh_rate);
+        fp->mode = pace_target_fps;
+        fp->target_fps = fp->refresh_rate;
+    }
+}
+
+void frame_pacer_start(frame_pacer *fp) {
+    fp->start_time = frame_pacer_now();
+    fp->start_cpu = frame_pacer_cpu_time();
+    fp->next_frame = fp->start_time;
+}
+
+// seconds between two frames, 0 for no wait
+static double frame_pacer_period(frame_pacer *fp,
+                                 struct gfx_context_t *ctxt) {
+    double fps = 0.0;
+    if (fp->mode == pace_target_fps) {
+        fps = fp->target_fps;
+    } else if (fp->mode == pace_vsync && ctxt->presenter != NULL) {
+        // the present thread waits for the display, not the main loop
+        fps = fp->refresh_rate;
+    }
+    if (fp->idle_fps > 0.0 && gfx_is_idle(ctxt)) {
+        fp->idle_frames += 1;
+        if (fps <= 0.0 || fp->idle_fps < fps) {
+            fps = fp->idle_fps;
+        }
+    }
+    return fps > 0.0 ? 1.0 / fps : 0.0;
+}
+
+void frame_pacer_wait(frame_pacer *fp, struct gfx_context_t *ctxt) {
+    fp->frames += 1;
+    double period = frame_pacer_period(fp, ctxt);
+    double now = frame_pacer_now();
+    if (period <= 0.0) {
+        fp->next_frame = now;
+        return;
+    }
+    fp->next_frame += period;
+    if (fp->next_frame < now - period) {
+        // too late to keep the cadence, start it again rather than
+        // catching up with a burst of frames
+        fp->next_frame = now;
+        return;
+    }
+
+    double sleep_time = fp->next_frame - fp->spin_time - now;
+    if (sleep_time > 0.0) {
+        struct timespec t;
+        t.tv_sec = (time_t)sleep_time;
+        t.tv_nsec = (long)((sleep_time - (double)t.tv_sec) * 1000000000.0);
+        nanosleep(&t, NULL);
+        double woken = frame_pacer_now();
+        fp->slept += woken - now;
+        now = woken;
+    }
+    double spin_start = now;
+    while (now < fp->next_frame) {
+        now = frame_pacer_now();
+    }
+    fp->spun += now - spin_start;
+}
+
+void frame_pacer_print(const frame_pacer *fp, FILE *out) {
+    double wall = frame_pacer_now() - fp->start_time;
+    double cpu = frame_pacer_cpu_time() - fp->start_cpu;
+    fprintf(out, "frame pacing: %s", frame_pacer_mode_name(fp->mode));
+    if (fp->mode == pace_target_fps) {
+        fprintf(out, " at %.0f", fp->target_fps);
+    }
+    fprintf(out, ", %lu frames (%lu idle), slept %.2f s, spun %.3f s\n",
+            fp->frames, fp->idle_frames, fp->slept, fp->spun);
+    if (fp->frames > 0 && wall > 0.0) {
+        fprintf(out, "cpu: %.2f ms per frame, %.0f%% of a core\n",
+                1000.0 * cpu / (double)fp->frames, 100.0 * cpu / wall);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef _FRAME_PACER_H_
+#define _FRAME_PACER_H_
+
+#include "gfx.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum {
+    pace_vsync,      // presenting waits for the display refresh
+    pace_target_fps, // the main loop waits for the next frame time
+    pace_unbounded   // frames as fast as possible
+} pace_mode;
+
+// Keeps the main loop from drawing more frames than anybody can see, and
+// even fewer while the window is minimized or in the background. Waits
+// sleep until shortly before the frame time and spin the rest, since a
+// sleep may overshoot.
+typedef struct _frame_pacer {
+    pace_mode mode;
+    double target_fps;   // with pace_target_fps
+    double idle_fps;     // cap while nobody looks at the window, 0 for none
+    double refresh_rate; // of the display, for vsync with the present thread
+    double spin_time;    // end of a wait spun instead of slept, in seconds
+    double next_frame;   // when the next frame may start
+    double start_time;
+    double start_cpu; // process CPU time, all the threads included
+    unsigned long frames;
+    unsigned long idle_frames;
+    double slept;
+    double spun;
+} frame_pacer;
+
+frame_pacer frame_pacer_create_default();
+
+// handles --vsync, --fps=<n>, --unbounded and --idle-fps=<n>, returns false
+// if arg is not for the pacing
+bool frame_pacer_parse_arg(frame_pacer *fp, const char *arg);
+
+// turns vsync on in the renderer, or paces at the display refresh rate if
+// it cannot. Called before streaming or starting the present thread.
+void frame_pacer_setup(frame_pacer *fp, struct gfx_context_t *ctxt);
+
+// right before the first frame
+void frame_pacer_start(frame_pacer *fp);
+
+// at the end of each frame, waits until the next one may start
+void frame_pacer_wait(frame_pacer *fp, struct gfx_context_t *ctxt);
+
+void frame_pacer_print(const frame_pacer *fp, FILE *out);
+
+#endif
@@ -6,15 +6,186 @@
 
 #include "gfx.h"
 #include "../geom/utils.h"
+#include "../threads/lock_prof.h"
 #include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-static int flip_vertical(int iy, int height) {
-    // assert(height >= iy);
-    if (height < iy) {
-        printf("height = %d, iy = %d\n", height, iy);
-        exit(1);
-    };
-    return height - iy;
+#define GFX_SPRITE_CACHE_SIZE 8
+#define GFX_BAND_ROWS 32
+#define GFX_DOTS_CHUNK 256
+#define GFX_NUM_SLOTS 3
+// above this fraction of the frame drawn, a clear or an upload is done in full
+#define GFX_DAMAGE_FULL_RATIO 0.5
+
+/// Outline of a circle of a given radius, as horizontal spans of pixels
+/// relative to its center.
+typedef struct gfx_sprite {
+    int radius;
+    int num_spans;
+    int *dy;
+    int *dx0;
+    int *dx1;     // last pixel of the span, included
+    int *offsets; // dx0 - dy * stride, for blits that do not wrap
+} gfx_sprite;
+
+/// The asteroids only have a few radii: their outlines are rasterized once
+/// for the current frame size.
+struct gfx_sprite_cache {
+    int stride;
+    int num_sprites;
+    int next_evicted;
+    gfx_sprite sprites[GFX_SPRITE_CACHE_SIZE];
+};
+
+/// Extents of the pixels touched on each row of the frame, so that clearing
+/// and uploading a frame only cost the parts actually drawn. A row is clean
+/// when its x0 > x1. The frame holds the clear color everywhere else.
+struct gfx_damage {
+    int *drawn_x0; // drawn since the last clear
+    int *drawn_x1;
+    bool full_upload; // cleared in full since the last upload, or unknown
+    bool full_clear;  // when the frame holds something else than the drawings
+    uint32_t clear_color;
+    int width; // of the frame last uploaded, for the texture
+    int height;
+};
+
+/// A frame handed from the thread drawing to the thread presenting.
+typedef struct gfx_slot {
+    uint32_t *pixels;
+    struct gfx_damage damage;
+    int width;
+    int height;
+} gfx_slot;
+
+/// Thread owning the renderer and the texture. The frames go through three
+/// slots: the one being drawn, the newest finished one and the one being
+/// shown. A finished frame that is not shown yet when the next one finishes
+/// is dropped, so that neither side ever waits for the other.
+struct gfx_presenter {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    gfx_slot slots[GFX_NUM_SLOTS];
+    struct gfx_damage *damage; // of the buffer, while the slots are used
+    int drawing;
+    int ready;   // -1 when no frame waits to be shown
+    int showing; // -1 when the thread is idle
+    bool started;
+    bool failed;
+    bool stop;
+    unsigned long published;
+    unsigned long presented;
+    unsigned long dropped;
+};
+
+/// Part of the frame a primitive is rasterized to: the rows outside of
+/// [row_begin, row_end) are left untouched.
+typedef struct gfx_target {
+    uint32_t *pixels;
+    int stride;
+    int width;
+    int height;
+    int row_begin;
+    int row_end;
+    struct gfx_damage *damage;
+    bool wrap; // false to clip the primitives to the frame instead
+} gfx_target;
+
+typedef enum gfx_command_kind {
+    gfx_command_clear,
+    gfx_command_sprite,
+    gfx_command_line,
+    gfx_command_span,
+} gfx_command_kind;
+
+/// A primitive already rescaled to the frame, waiting to be rasterized.
+typedef struct gfx_command {
+    gfx_command_kind kind;
+    uint32_t color;
+    int x0; // first end of a line, first pixel of a span, center of a sprite,
+            // non zero to clear the whole frame
+    int y0;
+    int x1; // second end of a line, last pixel of a span
+    int y1;
+    const gfx_sprite *sprite;
+} gfx_command;
+
+/// With a worker pool, the primitives are recorded instead of drawn. On
+/// flush, they are binned per band of GFX_BAND_ROWS rows and the bands are
+/// rasterized in parallel, each one replaying its commands in order.
+struct gfx_display_list {
+    worker_pool *pool;
+    stage_policy stage;
+    gfx_command *commands;
+    int num_commands;
+    int capacity;
+    int num_bands;
+    int bands_capacity;
+    int *band_start; // commands of band b: band_items[band_start[b]..[b + 1])
+    int *band_cursor;
+    int *band_items;
+    int items_capacity;
+};
+
+static void gfx_sprite_cache_flush(struct gfx_sprite_cache *cache);
+static void gfx_record(struct gfx_context_t *ctxt, gfx_command command);
+static gfx_target gfx_target_full(struct gfx_context_t *ctxt);
+static void gfx_target_clear(const gfx_target *target, uint32_t color,
+                             bool full);
+static bool gfx_damage_reset(struct gfx_damage *damage, int height);
+static bool gfx_damage_needs_full_clear(struct gfx_context_t *ctxt,
+                                        uint32_t color);
+static void gfx_damage_free(struct gfx_damage *damage);
+static void gfx_display_list_free(struct gfx_context_t *ctxt);
+static void gfx_upload(SDL_Texture *texture, const uint32_t *pixels,
+                       int stride, int width, int height,
+                       struct gfx_damage *frame, struct gfx_damage *shown);
+static bool gfx_create_renderer(struct gfx_context_t *ctxt);
+static void gfx_destroy_renderer(struct gfx_context_t *ctxt);
+static void gfx_publish(struct gfx_context_t *ctxt);
+static void gfx_map(struct gfx_context_t *ctxt);
+
+/// Set up the framebuffer and the state shared by all the backends.
+static struct gfx_context_t *gfx_create_context(SDL_Window *window,
+                                                uint width, uint height) {
+    uint32_t *buffer = malloc(width * height * sizeof(uint32_t));
+    struct gfx_context_t *ctxt = malloc(sizeof(struct gfx_context_t));
+
+    if (!buffer || !ctxt)
+        goto error;
+
+    ctxt->window = window;
+    ctxt->renderer = NULL;
+    ctxt->texture = NULL;
+    ctxt->width = (int)width;
+    ctxt->height = (int)height;
+    ctxt->tex_width = (int)width;
+    ctxt->tex_height = (int)height;
+    ctxt->buffer = buffer;
+    ctxt->pixels = buffer;
+    ctxt->stride = (int)width;
+    ctxt->streaming = false;
+    ctxt->headless = window == NULL;
+    ctxt->wrap = true;
+    ctxt->vsync = false;
+    ctxt->dump = NULL;
+    ctxt->sprites = calloc(1, sizeof(struct gfx_sprite_cache));
+    ctxt->display_list = NULL;
+    ctxt->presenter = NULL;
+    ctxt->damage = calloc(1, sizeof(struct gfx_damage));
+    ctxt->shown = calloc(1, sizeof(struct gfx_damage));
+    if (!ctxt->sprites || !ctxt->damage || !ctxt->shown ||
+        !gfx_damage_reset(ctxt->damage, (int)height) ||
+        !gfx_damage_reset(ctxt->shown, (int)height))
+        goto error;
+    return ctxt;
+
+error:
+    return NULL;
 }
 
 /// Create a fullscreen graphic window.
@@ -28,22 +199,11 @@ struct gfx_context_t *gfx_create(char *title, uint width, uint height) {
     SDL_Window *window = SDL_CreateWindow(title, SDL_WINDOWPOS_UNDEFINED,
                                           SDL_WINDOWPOS_UNDEFINED, width,
                                           height, SDL_WINDOW_RESIZABLE);
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, 0);
-    SDL_Texture *texture =
-        SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
-                          SDL_TEXTUREACCESS_STREAMING, width, height);
-    uint32_t *pixels = malloc(width * height * sizeof(uint32_t));
-    struct gfx_context_t *ctxt = malloc(sizeof(struct gfx_context_t));
-
-    if (!window || !renderer || !texture || !pixels || !ctxt)
+    if (!window)
+        goto error;
+    struct gfx_context_t *ctxt = gfx_create_context(window, width, height);
+    if (!ctxt || !gfx_create_renderer(ctxt))
         goto error;
-
-    ctxt->renderer = renderer;
-    ctxt->texture = texture;
-    ctxt->window = window;
-    ctxt->width = width;
-    ctxt->height = height;
-    ctxt->pixels = pixels;
 
     SDL_ShowCursor(SDL_DISABLE);
     gfx_clear(ctxt, COLOR_BLACK);
@@ -53,76 +213,773 @@ error:
     return NULL;
 }
 
+/// Create a graphic context without any window, for hosts without a
+/// display. The frames are drawn the same way but presenting them only
+/// writes them to the dump, if any.
+/// @param width Width of the frames in pixels.
+/// @param height Height of the frames in pixels.
+/// @param dump Where to write the frames presented, NULL to drop them. The
+/// context closes it when destroyed.
+/// @return a pointer to the graphic context or NULL if it failed.
+struct gfx_context_t *gfx_create_headless(uint width, uint height,
+                                          frame_dump *dump) {
+    struct gfx_context_t *ctxt = gfx_create_context(NULL, width, height);
+    if (!ctxt)
+        return NULL;
+    ctxt->dump = dump;
+    gfx_clear(ctxt, COLOR_BLACK);
+    return ctxt;
+}
+
 /// Draw a pixel in the specified graphic context.
 /// @param ctxt Graphic context where the pixel is to be drawn.
 /// @param x X coordinate of the pixel.
 /// @param y Y coordinate of the pixel.
 /// @param color Color of the pixel.
 void gfx_putpixel(struct gfx_context_t *ctxt, int x, int y, uint32_t color) {
-    if (x < ctxt->width && y < ctxt->height)
-        ctxt->pixels[ctxt->width * y + x] = color;
+    gfx_flush(ctxt);
+    gfx_map(ctxt);
+    if (x < ctxt->width && y < ctxt->height) {
+        ctxt->pixels[ctxt->stride * y + x] = color;
+        ctxt->damage->drawn_x0[y] = (int)min(ctxt->damage->drawn_x0[y], x);
+        ctxt->damage->drawn_x1[y] = (int)max(ctxt->damage->drawn_x1[y], x);
+    }
 }
 
 /// Clear the specified graphic context.
 /// @param ctxt Graphic context to clear.
 /// @param color Color to use.
 void gfx_clear(struct gfx_context_t *ctxt, uint32_t color) {
-    int n = ctxt->width * ctxt->height;
-    while (n)
-        ctxt->pixels[--n] = color;
+    gfx_map(ctxt);
+    bool full = gfx_damage_needs_full_clear(ctxt, color);
+    if (ctxt->display_list != NULL) {
+        // nothing recorded so far would remain visible
+        ctxt->display_list->num_commands = 0;
+        gfx_record(ctxt, (gfx_command){gfx_command_clear, color, full, 0, 0, 0,
+                                       NULL});
+        return;
+    }
+    gfx_target target = gfx_target_full(ctxt);
+    gfx_target_clear(&target, color, full);
 }
 
 /// Display the graphic context.
 /// @param ctxt Graphic context to clear.
 void gfx_present(struct gfx_context_t *ctxt) {
-    SDL_UpdateTexture(ctxt->texture, NULL, ctxt->pixels,
-                      ctxt->width * sizeof(uint32_t));
-    SDL_RenderCopy(ctxt->renderer, ctxt->texture, NULL, NULL);
+    gfx_flush(ctxt);
+    if (ctxt->presenter != NULL) {
+        gfx_publish(ctxt);
+        return;
+    }
+    if (ctxt->headless) {
+        if (ctxt->dump != NULL) {
+            frame_dump_write(ctxt->dump, ctxt->pixels, ctxt->stride,
+                             ctxt->width, ctxt->height);
+        }
+        return;
+    }
+    if (!ctxt->streaming) {
+        gfx_upload(ctxt->texture, ctxt->pixels, ctxt->stride, ctxt->width,
+                   ctxt->height, ctxt->damage, ctxt->shown);
+    } else if (ctxt->pixels != NULL) {
+        SDL_UnlockTexture(ctxt->texture);
+        ctxt->pixels = NULL;
+    }
+    SDL_Rect frame = {0, 0, ctxt->width, ctxt->height};
+    SDL_RenderCopy(ctxt->renderer, ctxt->texture, &frame, NULL);
     SDL_RenderPresent(ctxt->renderer);
 }
 
+/// Change the size of the frames drawn, they are upscaled to the window.
+/// The size is clamped to the one given at creation and the frame cleared.
+/// @param ctxt Graphic context.
+/// @param width Width of the next frames in pixels.
+/// @param height Height of the next frames in pixels.
+void gfx_set_render_size(struct gfx_context_t *ctxt, int width, int height) {
+    width = width < 1 ? 1 : (width > ctxt->tex_width ? ctxt->tex_width : width);
+    height = height < 1 ? 1
+                        : (height > ctxt->tex_height ? ctxt->tex_height : height);
+    if (width == ctxt->width && height == ctxt->height) {
+        return;
+    }
+    gfx_flush(ctxt);
+    ctxt->width = width;
+    ctxt->height = height;
+    if (!ctxt->streaming) {
+        ctxt->stride = width;
+    }
+    ctxt->damage->full_clear = true;
+    gfx_clear(ctxt, COLOR_BLACK);
+    gfx_flush(ctxt);
+}
+
+/// Choose whether the primitives crossing an edge of the frame come back on
+/// the other side, for a frame showing a whole periodic world, or are
+/// clipped, for a frame showing a part of it.
+/// @param ctxt Graphic context.
+/// @param wrap true to wrap around the edges, false to clip.
+void gfx_set_wrap(struct gfx_context_t *ctxt, bool wrap) {
+    gfx_flush(ctxt);
+    ctxt->wrap = wrap;
+}
+
+/// Size the frames are shown at: the window, bounded by the texture, since
+/// rendering more pixels than the window has is wasted.
+/// @param ctxt Graphic context.
+/// @param width Filled with the width in pixels.
+/// @param height Filled with the height in pixels.
+void gfx_output_size(struct gfx_context_t *ctxt, int *width, int *height) {
+    *width = ctxt->tex_width;
+    *height = ctxt->tex_height;
+    if (!ctxt->headless) {
+        SDL_GetWindowSize(ctxt->window, width, height);
+    }
+    *width = *width < 1 || *width > ctxt->tex_width ? ctxt->tex_width : *width;
+    *height = *height < 1 || *height > ctxt->tex_height ? ctxt->tex_height
+                                                         : *height;
+}
+
+/// Draw the next frames straight into the texture memory instead of a
+/// separate buffer copied at each present. The memory given by the texture
+/// does not keep the previous frame: each frame has to start with a clear.
+/// @param ctxt Graphic context.
+/// @param streaming true to draw into the texture, false for the buffer.
+void gfx_set_streaming(struct gfx_context_t *ctxt, bool streaming) {
+    if (streaming && ctxt->presenter != NULL) {
+        fprintf(stderr, "The texture belongs to the present thread, the frame "
+                        "is not drawn into it\n");
+        return;
+    }
+    if (streaming && ctxt->headless) {
+        fprintf(stderr, "There is no texture to draw into without a window\n");
+        return;
+    }
+    gfx_flush(ctxt);
+    if (ctxt->streaming && ctxt->pixels != NULL) {
+        SDL_UnlockTexture(ctxt->texture);
+    }
+    ctxt->streaming = streaming;
+    ctxt->pixels = streaming ? NULL : ctxt->buffer;
+    if (!streaming) {
+        ctxt->stride = ctxt->width;
+    }
+    ctxt->damage->full_clear = true;
+    ctxt->shown->full_upload = true;
+}
+
+/// Wait or not for the display refresh when presenting. The renderer is
+/// created again, so this is meant to be called before streaming into the
+/// texture or starting the present thread.
+/// @param ctxt Graphic context.
+/// @param vsync Whether to wait for the display refresh.
+/// @return true if the renderer actually waits for the display refresh.
+bool gfx_set_vsync(struct gfx_context_t *ctxt, bool vsync) {
+    if (ctxt->headless || ctxt->presenter != NULL || ctxt->streaming) {
+        return false;
+    }
+    if (ctxt->vsync != vsync) {
+        ctxt->vsync = vsync;
+        gfx_destroy_renderer(ctxt);
+        if (!gfx_create_renderer(ctxt)) {
+            fprintf(stderr, "SDL_CreateRenderer failed: %s\n",
+                    SDL_GetError());
+            ctxt->vsync = false;
+            gfx_create_renderer(ctxt);
+            return false;
+        }
+    }
+    SDL_RendererInfo info;
+    return vsync && ctxt->renderer != NULL &&
+           SDL_GetRendererInfo(ctxt->renderer, &info) == 0 &&
+           (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+}
+
+/// Whether nobody is looking at the frames: the window is minimized,
+/// hidden or does not have the focus.
+/// @param ctxt Graphic context.
+/// @return false without a window.
+bool gfx_is_idle(struct gfx_context_t *ctxt) {
+    if (ctxt->headless) {
+        return false;
+    }
+    Uint32 flags = SDL_GetWindowFlags(ctxt->window);
+    return (flags & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN)) != 0 ||
+           (flags & SDL_WINDOW_INPUT_FOCUS) == 0;
+}
+
+/// Refresh rate of the display showing the window.
+/// @param ctxt Graphic context.
+/// @return the frames per second of the display, 0 if unknown.
+double gfx_refresh_rate(struct gfx_context_t *ctxt) {
+    SDL_DisplayMode mode;
+    if (ctxt->headless || SDL_GetWindowDisplayMode(ctxt->window, &mode) != 0) {
+        return 0.0;
+    }
+    return mode.refresh_rate;
+}
+
+/// Lock the texture to draw into it, if the frame is drawn there and it is
+/// not locked yet.
+static void gfx_map(struct gfx_context_t *ctxt) {
+    if (!ctxt->streaming || ctxt->pixels != NULL) {
+        return;
+    }
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(ctxt->texture, NULL, &pixels, &pitch) != 0) {
+        fprintf(stderr, "SDL_LockTexture failed: %s\n", SDL_GetError());
+        // back to the buffer as gfx_set_streaming, whose flush would map
+        // the texture again
+        ctxt->streaming = false;
+        ctxt->pixels = ctxt->buffer;
+        ctxt->stride = ctxt->width;
+        ctxt->damage->full_clear = true;
+        ctxt->shown->full_upload = true;
+        return;
+    }
+    ctxt->pixels = pixels;
+    ctxt->stride = pitch / (int)sizeof(uint32_t);
+    // whatever the texture held is gone
+    ctxt->damage->full_clear = true;
+}
+
+/// Create the renderer and the texture, on the thread that will use them.
+static bool gfx_create_renderer(struct gfx_context_t *ctxt) {
+    ctxt->renderer = SDL_CreateRenderer(
+        ctxt->window, -1, ctxt->vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+    ctxt->texture = ctxt->renderer == NULL
+                        ? NULL
+                        : SDL_CreateTexture(ctxt->renderer,
+                                            SDL_PIXELFORMAT_ARGB8888,
+                                            SDL_TEXTUREACCESS_STREAMING,
+                                            ctxt->tex_width, ctxt->tex_height);
+    // whatever the texture holds is unknown
+    ctxt->shown->full_upload = true;
+    return ctxt->texture != NULL;
+}
+
+static void gfx_destroy_renderer(struct gfx_context_t *ctxt) {
+    if (ctxt->texture != NULL) {
+        SDL_DestroyTexture(ctxt->texture);
+    }
+    if (ctxt->renderer != NULL) {
+        SDL_DestroyRenderer(ctxt->renderer);
+    }
+    ctxt->texture = NULL;
+    ctxt->renderer = NULL;
+}
+
+static void gfx_use_slot(struct gfx_context_t *ctxt, int index) {
+    gfx_slot *slot = &ctxt->presenter->slots[index];
+    ctxt->pixels = slot->pixels;
+    ctxt->stride = ctxt->width;
+    ctxt->damage = &slot->damage;
+    if (slot->width != ctxt->width || slot->height != ctxt->height) {
+        // drawn at another size
+        ctxt->damage->full_clear = true;
+    }
+}
+
+/// Hand the frame drawn to the present thread and go on with a free slot.
+static void gfx_publish(struct gfx_context_t *ctxt) {
+    struct gfx_presenter *presenter = ctxt->presenter;
+    gfx_slot *slot = &presenter->slots[presenter->drawing];
+    slot->width = ctxt->width;
+    slot->height = ctxt->height;
+
+    PROF_MUTEX_LOCK(&presenter->mutex, "present");
+    int next = presenter->ready;
+    if (next >= 0) {
+        presenter->dropped += 1;
+    } else {
+        for (next = 0; next == presenter->drawing || next == presenter->showing;
+             ++next) {
+        }
+    }
+    presenter->ready = presenter->drawing;
+    presenter->drawing = next;
+    presenter->published += 1;
+    pthread_cond_signal(&presenter->cond);
+    pthread_mutex_unlock(&presenter->mutex);
+
+    gfx_use_slot(ctxt, next);
+}
+
+static void *gfx_present_thread(void *arg) {
+    struct gfx_context_t *ctxt = arg;
+    struct gfx_presenter *presenter = ctxt->presenter;
+
+    bool failed = !gfx_create_renderer(ctxt);
+    PROF_MUTEX_LOCK(&presenter->mutex, "present");
+    presenter->started = true;
+    presenter->failed = failed;
+    pthread_cond_broadcast(&presenter->cond);
+    pthread_mutex_unlock(&presenter->mutex);
+
+    while (!failed) {
+        PROF_MUTEX_LOCK(&presenter->mutex, "present");
+        while (presenter->ready < 0 && !presenter->stop) {
+            pthread_cond_wait(&presenter->cond, &presenter->mutex);
+        }
+        if (presenter->ready < 0) {
+            pthread_mutex_unlock(&presenter->mutex);
+            break;
+        }
+        presenter->showing = presenter->ready;
+        presenter->ready = -1;
+        pthread_mutex_unlock(&presenter->mutex);
+
+        gfx_slot *slot = &presenter->slots[presenter->showing];
+        gfx_upload(ctxt->texture, slot->pixels, slot->width, slot->width,
+                   slot->height, &slot->damage, ctxt->shown);
+        SDL_Rect frame = {0, 0, slot->width, slot->height};
+        SDL_RenderCopy(ctxt->renderer, ctxt->texture, &frame, NULL);
+        SDL_RenderPresent(ctxt->renderer);
+
+        PROF_MUTEX_LOCK(&presenter->mutex, "present");
+        presenter->showing = -1;
+        presenter->presented += 1;
+        pthread_mutex_unlock(&presenter->mutex);
+    }
+
+    gfx_destroy_renderer(ctxt);
+    return NULL;
+}
+
+static void gfx_presenter_free(struct gfx_presenter *presenter) {
+    for (int i = 0; i < GFX_NUM_SLOTS; ++i) {
+        free(presenter->slots[i].pixels);
+        gfx_damage_free(&presenter->slots[i].damage);
+    }
+    pthread_mutex_destroy(&presenter->mutex);
+    pthread_cond_destroy(&presenter->cond);
+    free(presenter);
+}
+
+/// Whether a renderer can be used on another thread than the one that
+/// created the window: only X11 on Linux allows it, the other video drivers
+/// (Cocoa, Windows, Wayland...) wanting the main thread.
+/// @return true if the present thread can be started.
+static bool gfx_present_thread_supported(void) {
+#ifdef __linux__
+    const char *driver = SDL_GetCurrentVideoDriver();
+    return driver != NULL && strcmp(driver, "x11") == 0;
+#else
+    return false;
+#endif
+}
+
+/// Present the frames on a thread of their own, which takes the renderer
+/// and the texture over. gfx_present then only hands the frame to it.
+/// Drawing into the texture is not possible anymore. Only supported on
+/// Linux with X11, elsewhere the frames stay presented on the calling thread.
+/// @param ctxt Graphic context.
+/// @return false if the thread is not supported or could not set the
+/// renderer up.
+bool gfx_start_present_thread(struct gfx_context_t *ctxt) {
+    if (ctxt->presenter != NULL) {
+        return true;
+    }
+    if (ctxt->headless) {
+        fprintf(stderr, "There is nothing to present without a window\n");
+        return false;
+    }
+    if (!gfx_present_thread_supported()) {
+        fprintf(stderr, "Presenting on another thread needs Linux and X11, "
+                        "presenting on the render thread\n");
+        return false;
+    }
+    gfx_set_streaming(ctxt, false);
+
+    struct gfx_presenter *presenter = calloc(1, sizeof(struct gfx_presenter));
+    if (presenter == NULL) {
+        return false;
+    }
+    size_t frame_size = (size_t)ctxt->tex_width * (size_t)ctxt->tex_height;
+    for (int i = 0; i < GFX_NUM_SLOTS; ++i) {
+        presenter->slots[i].pixels = malloc(frame_size * sizeof(uint32_t));
+        if (presenter->slots[i].pixels == NULL ||
+            !gfx_damage_reset(&presenter->slots[i].damage, ctxt->tex_height)) {
+            gfx_presenter_free(presenter);
+            return false;
+        }
+    }
+    pthread_mutex_init(&presenter->mutex, NULL);
+    pthread_cond_init(&presenter->cond, NULL);
+    presenter->damage = ctxt->damage;
+    presenter->drawing = 0;
+    presenter->ready = -1;
+    presenter->showing = -1;
+
+    // SDL wants the renderer used by the thread that created it
+    gfx_destroy_renderer(ctxt);
+    ctxt->presenter = presenter;
+    pthread_create(&presenter->thread, NULL, gfx_present_thread, ctxt);
+
+    PROF_MUTEX_LOCK(&presenter->mutex, "present");
+    while (!presenter->started) {
+        pthread_cond_wait(&presenter->cond, &presenter->mutex);
+    }
+    pthread_mutex_unlock(&presenter->mutex);
+
+    if (presenter->failed) {
+        fprintf(stderr, "The present thread could not create a renderer: %s\n",
+                SDL_GetError());
+        pthread_join(presenter->thread, NULL);
+        ctxt->presenter = NULL;
+        gfx_presenter_free(presenter);
+        gfx_create_renderer(ctxt);
+        return false;
+    }
+    gfx_use_slot(ctxt, presenter->drawing);
+    return true;
+}
+
+/// Show the last frame handed over, stop the present thread and present
+/// again on the calling thread.
+/// @param ctxt Graphic context.
+void gfx_stop_present_thread(struct gfx_context_t *ctxt) {
+    struct gfx_presenter *presenter = ctxt->presenter;
+    if (presenter == NULL) {
+        return;
+    }
+    gfx_flush(ctxt);
+    PROF_MUTEX_LOCK(&presenter->mutex, "present");
+    presenter->stop = true;
+    pthread_cond_signal(&presenter->cond);
+    pthread_mutex_unlock(&presenter->mutex);
+    pthread_join(presenter->thread, NULL);
+
+    ctxt->presenter = NULL;
+    ctxt->pixels = ctxt->buffer;
+    ctxt->stride = ctxt->width;
+    ctxt->damage = presenter->damage;
+    ctxt->damage->full_clear = true;
+    gfx_presenter_free(presenter);
+    gfx_create_renderer(ctxt);
+}
+
+/// Print how many frames the present thread showed and dropped.
+/// @param ctxt Graphic context.
+/// @param out Stream to print to.
+void gfx_print_present_stats(struct gfx_context_t *ctxt, FILE *out) {
+    struct gfx_presenter *presenter = ctxt->presenter;
+    if (presenter == NULL) {
+        return;
+    }
+    PROF_MUTEX_LOCK(&presenter->mutex, "present");
+    fprintf(out, "present thread: %lu frames handed over, %lu shown, %lu "
+                 "dropped\n",
+            presenter->published, presenter->presented, presenter->dropped);
+    pthread_mutex_unlock(&presenter->mutex);
+}
+
 /// Destroy a graphic window.
 /// @param ctxt Graphic context of the window to close.
 void gfx_destroy(struct gfx_context_t *ctxt) {
-    SDL_ShowCursor(SDL_ENABLE);
-    SDL_DestroyTexture(ctxt->texture);
-    SDL_DestroyRenderer(ctxt->renderer);
-    SDL_DestroyWindow(ctxt->window);
-    free(ctxt->pixels);
+    if (!ctxt->headless) {
+        SDL_ShowCursor(SDL_ENABLE);
+    }
+    gfx_stop_present_thread(ctxt);
+    gfx_set_streaming(ctxt, false);
+    gfx_destroy_renderer(ctxt);
+    if (!ctxt->headless) {
+        SDL_DestroyWindow(ctxt->window);
+    }
+    frame_dump_close(ctxt->dump);
+    free(ctxt->buffer);
+    gfx_display_list_free(ctxt);
+    gfx_damage_free(ctxt->damage);
+    free(ctxt->damage);
+    gfx_damage_free(ctxt->shown);
+    free(ctxt->shown);
+    gfx_sprite_cache_flush(ctxt->sprites);
+    free(ctxt->sprites);
     ctxt->texture = NULL;
     ctxt->renderer = NULL;
     ctxt->window = NULL;
     ctxt->pixels = NULL;
-    SDL_Quit();
+    ctxt->buffer = NULL;
+    ctxt->dump = NULL;
+    if (!ctxt->headless) {
+        SDL_Quit();
+    }
     free(ctxt);
 }
 
-/// If a key was pressed, returns its key code (non blocking call).
+/// Drains all the pending events (non blocking call), reporting the keys
+/// pressed and released to on_key. The repeats of a held key are skipped.
 /// List of key codes: https://wiki.libsdl.org/SDL_Keycode
-/// @return the key that was pressed or 0 if none was pressed.
-SDL_Keycode gfx_keypressed() {
+/// @param quit set when escape is pressed or the window is closed.
+/// @return the number of key events reported.
+int gfx_poll_keys(gfx_key_fn on_key, void *ctx, bool *quit) {
+    int count = 0;
     SDL_Event event;
-    if (SDL_PollEvent(&event)) {
-        if (event.type == SDL_KEYDOWN)
-            return event.key.keysym.sym;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+            *quit = true;
+            continue;
+        }
+        if ((event.type != SDL_KEYDOWN && event.type != SDL_KEYUP) ||
+            event.key.repeat) {
+            continue;
+        }
+        bool down = event.type == SDL_KEYDOWN;
+        if (down && gfx_interpret_key(event.key.keysym.sym) == exit_game) {
+            *quit = true;
+        }
+        Uint32 age = SDL_GetTicks() - event.key.timestamp;
+        on_key(ctx, event.key.keysym.sym, down, age / 1000.0);
+        count += 1;
     }
-    return 0;
+    return count;
 }
 
-void gfx_draw_circle(struct gfx_context_t *ctxt, vec pos, double r,
-                     uint32_t color, double x0, double x1, double y0,
-                     double y1) {
+static int wrap(int i, int n) {
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+static void gfx_fill(uint32_t *p, int n, uint32_t color) {
+    for (int i = 0; i < n; ++i) {
+        p[i] = color;
+    }
+}
+
+static gfx_target gfx_target_full(struct gfx_context_t *ctxt) {
+    return (gfx_target){ctxt->pixels, ctxt->stride, ctxt->width,
+                        ctxt->height, 0,            ctxt->height,
+                        ctxt->damage, ctxt->wrap};
+}
+
+static void gfx_damage_mark(const gfx_target *target, int row, int x0,
+                            int x1) {
+    struct gfx_damage *damage = target->damage;
+    damage->drawn_x0[row] = (int)min(damage->drawn_x0[row], x0);
+    damage->drawn_x1[row] = (int)max(damage->drawn_x1[row], x1);
+}
+
+static void gfx_damage_merge(int *x0, int *x1, int from_x0, int from_x1) {
+    if (from_x0 <= from_x1) {
+        *x0 = (int)min(*x0, from_x0);
+        *x1 = (int)max(*x1, from_x1);
+    }
+}
+
+/// Allocate the extents for frames of up to height rows, all of them dirty.
+static bool gfx_damage_reset(struct gfx_damage *damage, int height) {
+    damage->drawn_x0 = malloc((size_t)height * sizeof(int));
+    damage->drawn_x1 = malloc((size_t)height * sizeof(int));
+    if (!damage->drawn_x0 || !damage->drawn_x1) {
+        return false;
+    }
+    for (int row = 0; row < height; ++row) {
+        damage->drawn_x0[row] = INT_MAX;
+        damage->drawn_x1[row] = INT_MIN;
+    }
+    damage->full_clear = true;
+    damage->full_upload = true;
+    return true;
+}
+
+static void gfx_damage_free(struct gfx_damage *damage) {
+    free(damage->drawn_x0);
+    free(damage->drawn_x1);
+}
+
+static int gfx_damage_area(const int *x0, const int *x1, int height) {
+    int area = 0;
+    for (int row = 0; row < height; ++row) {
+        area += x0[row] <= x1[row] ? x1[row] - x0[row] + 1 : 0;
+    }
+    return area;
+}
+
+/// Tells whether the next clear has to cover the whole frame rather than
+/// only what was drawn since the previous one.
+static bool gfx_damage_needs_full_clear(struct gfx_context_t *ctxt,
+                                        uint32_t color) {
+    struct gfx_damage *damage = ctxt->damage;
+    bool full = damage->full_clear || color != damage->clear_color ||
+                gfx_damage_area(damage->drawn_x0, damage->drawn_x1,
+                                ctxt->height) >
+                    GFX_DAMAGE_FULL_RATIO * ctxt->width * ctxt->height;
+    damage->clear_color = color;
+    damage->full_clear = false;
+    if (full) {
+        damage->full_upload = true;
+    }
+    return full;
+}
+
+/// Clear the rows of a target, or only what was drawn on them since the
+/// last clear.
+static void gfx_target_clear(const gfx_target *target, uint32_t color,
+                             bool full) {
+    struct gfx_damage *damage = target->damage;
+    int stride = target->stride;
+    if (full && stride == target->width) {
+        gfx_fill(target->pixels + target->row_begin * stride,
+                 (target->row_end - target->row_begin) * stride, color);
+    } else if (full) {
+        for (int row = target->row_begin; row < target->row_end; ++row) {
+            gfx_fill(target->pixels + row * stride, target->width, color);
+        }
+    }
+    for (int row = target->row_begin; row < target->row_end; ++row) {
+        int x0 = damage->drawn_x0[row];
+        int x1 = damage->drawn_x1[row];
+        if (x0 > x1) {
+            continue;
+        }
+        if (!full) {
+            gfx_fill(target->pixels + row * stride + x0, x1 - x0 + 1, color);
+        }
+        damage->drawn_x0[row] = INT_MAX;
+        damage->drawn_x1[row] = INT_MIN;
+    }
+}
+
+/// Copy to the texture the rows that differ from what it shows, merged in
+/// one rectangle per band of rows. Both frames only differ where one of
+/// them was drawn.
+/// @param texture Texture to update.
+/// @param pixels Frame to upload.
+/// @param stride Distance between two rows of the frame.
+/// @param width Width of the frame.
+/// @param height Height of the frame.
+/// @param frame Parts drawn on the frame.
+/// @param shown Parts drawn on the frame the texture shows, updated.
+static void gfx_upload(SDL_Texture *texture, const uint32_t *pixels,
+                       int stride, int width, int height,
+                       struct gfx_damage *frame, struct gfx_damage *shown) {
+    for (int row = 0; row < height; ++row) {
+        gfx_damage_merge(&shown->drawn_x0[row], &shown->drawn_x1[row],
+                         frame->drawn_x0[row], frame->drawn_x1[row]);
+    }
+
+    if (frame->full_upload || shown->full_upload ||
+        frame->clear_color != shown->clear_color || width != shown->width ||
+        height != shown->height ||
+        gfx_damage_area(shown->drawn_x0, shown->drawn_x1, height) >
+            GFX_DAMAGE_FULL_RATIO * width * height) {
+        SDL_Rect rect = {0, 0, width, height};
+        SDL_UpdateTexture(texture, &rect, pixels,
+                          stride * (int)sizeof(uint32_t));
+    } else {
+        for (int band = 0; band < height; band += GFX_BAND_ROWS) {
+            int band_end = (int)min(band + GFX_BAND_ROWS, height);
+            int x0 = INT_MAX;
+            int x1 = INT_MIN;
+            int row_begin = band_end;
+            int row_end = band;
+            for (int row = band; row < band_end; ++row) {
+                if (shown->drawn_x0[row] <= shown->drawn_x1[row]) {
+                    gfx_damage_merge(&x0, &x1, shown->drawn_x0[row],
+                                     shown->drawn_x1[row]);
+                    row_begin = (int)min(row_begin, row);
+                    row_end = row + 1;
+                }
+            }
+            if (x0 > x1) {
+                continue;
+            }
+            SDL_Rect rect = {x0, row_begin, x1 - x0 + 1, row_end - row_begin};
+            SDL_UpdateTexture(texture, &rect, pixels + row_begin * stride + x0,
+                              stride * (int)sizeof(uint32_t));
+        }
+    }
+
+    memcpy(shown->drawn_x0, frame->drawn_x0, (size_t)height * sizeof(int));
+    memcpy(shown->drawn_x1, frame->drawn_x1, (size_t)height * sizeof(int));
+    frame->full_upload = false;
+    shown->full_upload = false;
+    shown->clear_color = frame->clear_color;
+    shown->width = width;
+    shown->height = height;
+}
+
+/// Draw a horizontal span of pixels, wrapping around the edges of the frame
+/// or clipped to them. All the primitives end up here when they cross an
+/// edge.
+/// @param target Part of the frame to draw to.
+/// @param y Y coordinate of the span, from the bottom.
+/// @param xa X coordinate of its first pixel.
+/// @param xb X coordinate of its last pixel, xb >= xa.
+/// @param color Color of the span.
+static void gfx_hspan(const gfx_target *target, int y, int xa, int xb,
+                      uint32_t color) {
+    int width = target->width;
+    int height = target->height;
+    if (target->wrap) {
+        y = wrap(y, height);
+    } else if (y < 0 || y >= height) {
+        return;
+    }
+    if (y == 0) {
+        return; // flipped just outside of the frame
+    }
+    int row_index = height - y;
+    if (row_index < target->row_begin || row_index >= target->row_end) {
+        return;
+    }
+    uint32_t *row = target->pixels + row_index * target->stride;
+
+    if (!target->wrap) {
+        xa = (int)max(xa, 0);
+        xb = (int)min(xb, width - 1);
+        if (xa <= xb) {
+            gfx_fill(row + xa, xb - xa + 1, color);
+            gfx_damage_mark(target, row_index, xa, xb);
+        }
+        return;
+    }
+
+    int length = xb - xa + 1;
+    if (length >= width) {
+        gfx_fill(row, width, color);
+        gfx_damage_mark(target, row_index, 0, width - 1);
+        return;
+    }
+    xa = wrap(xa, width);
+    if (xa + length <= width) {
+        gfx_fill(row + xa, length, color);
+        gfx_damage_mark(target, row_index, xa, xa + length - 1);
+    } else {
+        gfx_fill(row + xa, width - xa, color);
+        gfx_fill(row, xa + length - width, color);
+        gfx_damage_mark(target, row_index, 0, width - 1);
+    }
+}
+
+static void gfx_sprite_free(gfx_sprite *sprite) {
+    free(sprite->dy);
+    free(sprite->dx0);
+    free(sprite->dx1);
+    free(sprite->offsets);
+    *sprite = (gfx_sprite){0};
+}
+
+static void gfx_sprite_cache_flush(struct gfx_sprite_cache *cache) {
+    for (int i = 0; i < cache->num_sprites; ++i) {
+        gfx_sprite_free(&cache->sprites[i]);
+    }
+    cache->num_sprites = 0;
+    cache->next_evicted = 0;
+}
+
+/// Rasterize the outline of a circle once and for all.
+/// @param sprite Sprite to fill.
+/// @param radius Radius of the circle in pixels.
+/// @param stride Distance between two rows of the frame it is blitted to.
+static void gfx_sprite_rasterize(gfx_sprite *sprite, int radius, int stride) {
     // copy paste from the algo
     // https://fr.wikipedia.org/wiki/Algorithme_de_trac%C3%A9_d%27arc_de_cercle_de_Bresenham
-    int width = ctxt->width;
-    int height = ctxt->height;
+    int side = 2 * radius + 3;
+    bool *seen = calloc((size_t)(side * side), sizeof(bool));
 
-    int rescaled_x = (int)rescale_to_window(0, width, x0, x1, pos.x);
-    int rescaled_y = (int)rescale_to_window(0, height, y0, y1, pos.y);
-    int rescaled_radius = (int)rescale_to_window(0, width, x0, x1, r);
-
-    int y = rescaled_radius;
-    int m = 3 - 2 * rescaled_radius;
+    int y = radius;
+    int m = 3 - 2 * radius;
     for (int x = 0; x <= y; ++x) {
         if (m < 0) {
             m += 4 * x + 6;
@@ -131,37 +988,104 @@ void gfx_draw_circle(struct gfx_context_t *ctxt, vec pos, double r,
             m += (4 * (x - y) + 10);
         }
 
-        gfx_putpixel(ctxt, (x + rescaled_x + width) % width,
-                     flip_vertical((y + rescaled_y + height) % height, height),
-                     color);
-        gfx_putpixel(ctxt, (y + rescaled_x + width) % width,
-                     flip_vertical((x + rescaled_y + height) % height, height),
-                     color);
-        gfx_putpixel(ctxt, (-x + rescaled_x + width) % width,
-                     flip_vertical((y + rescaled_y + height) % height, height),
-                     color);
-        gfx_putpixel(ctxt, (-y + rescaled_x + width) % width,
-                     flip_vertical((x + rescaled_y + height) % height, height),
-                     color);
-        gfx_putpixel(ctxt, (x + rescaled_x + width) % width,
-                     flip_vertical((-y + rescaled_y + height) % height, height),
-                     color);
-        gfx_putpixel(ctxt, (y + rescaled_x + width) % width,
-                     flip_vertical((-x + rescaled_y + height) % height, height),
-                     color);
-        gfx_putpixel(ctxt, (-x + rescaled_x + width) % width,
-                     flip_vertical((-y + rescaled_y + height) % height, height),
-                     color);
-        gfx_putpixel(ctxt, (-y + rescaled_x + width) % width,
-                     flip_vertical((-x + rescaled_y + height) % height, height),
-                     color);
+        int octants[8][2] = {{x, y},  {y, x},  {-x, y},  {-y, x},
+                             {x, -y}, {y, -x}, {-x, -y}, {-y, -x}};
+        for (int o = 0; o < 8; ++o) {
+            seen[(octants[o][1] + radius + 1) * side + octants[o][0] + radius +
+                 1] = true;
+        }
+    }
+
+    int capacity = 8 * (radius + 2);
+    sprite->radius = radius;
+    sprite->num_spans = 0;
+    sprite->dy = malloc((size_t)capacity * sizeof(int));
+    sprite->dx0 = malloc((size_t)capacity * sizeof(int));
+    sprite->dx1 = malloc((size_t)capacity * sizeof(int));
+    sprite->offsets = malloc((size_t)capacity * sizeof(int));
+    for (int row = 0; row < side; ++row) {
+        for (int col = 0; col < side; ++col) {
+            if (!seen[row * side + col]) {
+                continue;
+            }
+            int end = col;
+            while (end + 1 < side && seen[row * side + end + 1]) {
+                end += 1;
+            }
+            int n = sprite->num_spans++;
+            sprite->dy[n] = row - radius - 1;
+            sprite->dx0[n] = col - radius - 1;
+            sprite->dx1[n] = end - radius - 1;
+            sprite->offsets[n] = sprite->dx0[n] - sprite->dy[n] * stride;
+            col = end;
+        }
     }
+    free(seen);
 }
 
-extern void gfx_draw_line(struct gfx_context_t *ctxt, int x0, int x1, int y0,
-                          int y1, uint32_t color) {
-    int width = ctxt->width;
-    int height = ctxt->height;
+static const gfx_sprite *gfx_sprite_get(struct gfx_context_t *ctxt,
+                                        int radius) {
+    struct gfx_sprite_cache *cache = ctxt->sprites;
+    if (cache->stride != ctxt->stride) {
+        gfx_sprite_cache_flush(cache);
+        cache->stride = ctxt->stride;
+    }
+    for (int i = 0; i < cache->num_sprites; ++i) {
+        if (cache->sprites[i].radius == radius) {
+            return &cache->sprites[i];
+        }
+    }
+
+    gfx_sprite *sprite;
+    if (cache->num_sprites < GFX_SPRITE_CACHE_SIZE) {
+        sprite = &cache->sprites[cache->num_sprites++];
+    } else {
+        // the commands recorded so far may still use the evicted sprite
+        gfx_flush(ctxt);
+        sprite = &cache->sprites[cache->next_evicted];
+        cache->next_evicted = (cache->next_evicted + 1) % GFX_SPRITE_CACHE_SIZE;
+        gfx_sprite_free(sprite);
+    }
+    gfx_sprite_rasterize(sprite, radius, ctxt->stride);
+    return sprite;
+}
+
+/// Blit a sprite, wrapping around the edges of the frame.
+/// @param target Part of the frame to draw to.
+/// @param sprite Sprite to blit.
+/// @param x X coordinate of its center, from the left.
+/// @param y Y coordinate of its center, from the bottom.
+/// @param color Color of the sprite.
+static void gfx_blit_sprite(const gfx_target *target, const gfx_sprite *sprite,
+                            int x, int y, uint32_t color) {
+    int width = target->width;
+    int height = target->height;
+    int r = sprite->radius + 1;
+
+    // row 0 is the bottom line flipped just outside of the frame
+    if (x - r >= 0 && x + r < width && y - r >= 1 && y + r < height &&
+        height - y - r >= target->row_begin &&
+        height - y + r < target->row_end) {
+        uint32_t *center = target->pixels + (height - y) * target->stride + x;
+        for (int i = 0; i < sprite->num_spans; ++i) {
+            gfx_fill(center + sprite->offsets[i],
+                     sprite->dx1[i] - sprite->dx0[i] + 1, color);
+            gfx_damage_mark(target, height - y - sprite->dy[i],
+                            x + sprite->dx0[i], x + sprite->dx1[i]);
+        }
+        return;
+    }
+
+    for (int i = 0; i < sprite->num_spans; ++i) {
+        gfx_hspan(target, y + sprite->dy[i], x + sprite->dx0[i],
+                  x + sprite->dx1[i], color);
+    }
+}
+
+static void gfx_line(const gfx_target *target, int x0, int x1, int y0, int y1,
+                     uint32_t color) {
+    int width = target->width;
+    int height = target->height;
     // copy pasta from
     // <https://en.wikipedia.org/wiki/Bresenham%27s_line_algorithm>
     int dx = abs(x1 - x0);
@@ -169,10 +1093,40 @@ extern void gfx_draw_line(struct gfx_context_t *ctxt, int x0, int x1, int y0,
     int dy = -abs(y1 - y0);
     int sy = y0 < y1 ? 1 : -1;
     int err = dx + dy; /* error value e_xy */
-    while (true) {     /* loop */
-        int pos_x = (x0 + width) % width;
-        int pos_y = (y0 + height) % height;
-        gfx_putpixel(ctxt, pos_x, flip_vertical(pos_y, height), color);
+
+    if (min(x0, x1) >= 0 && max(x0, x1) < width && min(y0, y1) >= 1 &&
+        max(y0, y1) < height && height - max(y0, y1) >= target->row_begin &&
+        height - min(y0, y1) < target->row_end) {
+        // no wrapping: walk the frame directly
+        for (int row = height - (int)max(y0, y1);
+             row <= height - (int)min(y0, y1); ++row) {
+            gfx_damage_mark(target, row, (int)min(x0, x1), (int)max(x0, x1));
+        }
+        uint32_t *p = target->pixels + (height - y0) * target->stride + x0;
+        while (true) {
+            *p = color;
+            if (x0 == x1 && y0 == y1)
+                break;
+            int e2 = 2 * err;
+            if (e2 >= dy) {
+                err += dy;
+                x0 += sx;
+                p += sx;
+            }
+            if (e2 <= dx) {
+                err += dx;
+                y0 += sy;
+                p -= sy * target->stride;
+            }
+        }
+        return;
+    }
+
+    // the pixels of a same row are contiguous: draw them as spans
+    int span_y = y0;
+    int span_x0 = x0;
+    int span_x1 = x0;
+    while (true) { /* loop */
         if (x0 == x1 && y0 == y1)
             break;
         int e2 = 2 * err;
@@ -184,7 +1138,238 @@ extern void gfx_draw_line(struct gfx_context_t *ctxt, int x0, int x1, int y0,
             err += dx; /* e_xy+e_y < 0 */
             y0 += sy;
         }
+        if (y0 != span_y) {
+            gfx_hspan(target, span_y, (int)min(span_x0, span_x1),
+                      (int)max(span_x0, span_x1), color);
+            span_y = y0;
+            span_x0 = x0;
+        }
+        span_x1 = x0;
+    }
+    gfx_hspan(target, span_y, (int)min(span_x0, span_x1),
+              (int)max(span_x0, span_x1), color);
+}
+
+static void gfx_record(struct gfx_context_t *ctxt, gfx_command command) {
+    struct gfx_display_list *list = ctxt->display_list;
+    if (list->num_commands == list->capacity) {
+        list->capacity = list->capacity == 0 ? 256 : 2 * list->capacity;
+        list->commands = realloc(list->commands,
+                                 (size_t)list->capacity * sizeof(gfx_command));
+    }
+    list->commands[list->num_commands++] = command;
+}
+
+/// Calls fn on the bands covered by the rows a command may draw to.
+static void gfx_command_bands(const gfx_command *command, int height,
+                              int num_bands,
+                              void (*fn)(struct gfx_display_list *, int, int),
+                              struct gfx_display_list *list, int index) {
+    int y_min, y_max;
+    switch (command->kind) {
+    case gfx_command_sprite:
+        y_min = command->y0 - command->sprite->radius - 1;
+        y_max = command->y0 + command->sprite->radius + 1;
+        break;
+    case gfx_command_line:
+        y_min = (int)min(command->y0, command->y1);
+        y_max = (int)max(command->y0, command->y1);
+        break;
+    case gfx_command_span:
+        y_min = y_max = command->y0;
+        break;
+    default:
+        y_min = 0;
+        y_max = height;
+        break;
+    }
+
+    // row = height - y, wrapped around the frame
+    int length = y_max - y_min + 1;
+    int first_band = 0;
+    int last_band = num_bands - 1;
+    int lo = wrap(height - y_max, height);
+    if (length < height && lo + length <= height) {
+        first_band = lo / GFX_BAND_ROWS;
+        last_band = (lo + length - 1) / GFX_BAND_ROWS;
+    } else if (length < height) {
+        first_band = lo / GFX_BAND_ROWS;
+        int wrapped_band = (lo + length - 1 - height) / GFX_BAND_ROWS;
+        for (int b = 0; b <= wrapped_band && b < first_band; ++b) {
+            fn(list, b, index);
+        }
+    }
+    for (int b = first_band; b <= last_band; ++b) {
+        fn(list, b, index);
+    }
+}
+
+static void gfx_band_count(struct gfx_display_list *list, int band, int index) {
+    (void)index;
+    list->band_start[band + 1] += 1;
+}
+
+static void gfx_band_fill(struct gfx_display_list *list, int band, int index) {
+    list->band_items[list->band_cursor[band]++] = index;
+}
+
+static void gfx_display_list_bin(struct gfx_display_list *list, int height) {
+    int num_bands = (height + GFX_BAND_ROWS - 1) / GFX_BAND_ROWS;
+    if (num_bands > list->bands_capacity) {
+        list->bands_capacity = num_bands;
+        list->band_start =
+            realloc(list->band_start, (size_t)(num_bands + 1) * sizeof(int));
+        list->band_cursor =
+            realloc(list->band_cursor, (size_t)num_bands * sizeof(int));
+    }
+    list->num_bands = num_bands;
+
+    memset(list->band_start, 0, (size_t)(num_bands + 1) * sizeof(int));
+    for (int i = 0; i < list->num_commands; ++i) {
+        gfx_command_bands(&list->commands[i], height, num_bands,
+                          gfx_band_count, list, i);
+    }
+    for (int b = 0; b < num_bands; ++b) {
+        list->band_start[b + 1] += list->band_start[b];
+        list->band_cursor[b] = list->band_start[b];
+    }
+    int num_items = list->band_start[num_bands];
+    if (num_items > list->items_capacity) {
+        list->items_capacity = num_items;
+        list->band_items =
+            realloc(list->band_items, (size_t)num_items * sizeof(int));
+    }
+    for (int i = 0; i < list->num_commands; ++i) {
+        gfx_command_bands(&list->commands[i], height, num_bands, gfx_band_fill,
+                          list, i);
+    }
+}
+
+static void gfx_execute(const gfx_target *target, const gfx_command *command) {
+    switch (command->kind) {
+    case gfx_command_clear:
+        gfx_target_clear(target, command->color, command->x0 != 0);
+        break;
+    case gfx_command_sprite:
+        gfx_blit_sprite(target, command->sprite, command->x0, command->y0,
+                        command->color);
+        break;
+    case gfx_command_line:
+        gfx_line(target, command->x0, command->x1, command->y0, command->y1,
+                 command->color);
+        break;
+    case gfx_command_span:
+        gfx_hspan(target, command->y0, command->x0, command->x1,
+                  command->color);
+        break;
+    }
+}
+
+static void gfx_rasterize_bands(void *arg, int begin, int end) {
+    struct gfx_context_t *ctxt = arg;
+    struct gfx_display_list *list = ctxt->display_list;
+    for (int b = begin; b < end; ++b) {
+        gfx_target target = gfx_target_full(ctxt);
+        target.row_begin = b * GFX_BAND_ROWS;
+        target.row_end =
+            (int)min(target.row_begin + GFX_BAND_ROWS, ctxt->height);
+        for (int i = list->band_start[b]; i < list->band_start[b + 1]; ++i) {
+            gfx_execute(&target, &list->commands[list->band_items[i]]);
+        }
+    }
+}
+
+/// Rasterize the primitives recorded since the last flush, if any.
+/// @param ctxt Graphic context.
+void gfx_flush(struct gfx_context_t *ctxt) {
+    struct gfx_display_list *list = ctxt->display_list;
+    if (list == NULL || list->num_commands == 0) {
+        return;
+    }
+    gfx_map(ctxt);
+    gfx_display_list_bin(list, ctxt->height);
+    stage_policy_run(&list->stage, list->pool, list->num_bands,
+                     gfx_rasterize_bands, ctxt);
+    list->num_commands = 0;
+}
+
+/// Rasterize the next frames in bands on a worker pool, NULL to go back to
+/// drawing each primitive as soon as it is given.
+/// @param ctxt Graphic context.
+/// @param pool Worker pool, the calling thread takes part in the work.
+void gfx_set_worker_pool(struct gfx_context_t *ctxt, worker_pool *pool) {
+    gfx_flush(ctxt);
+    if (pool == NULL) {
+        gfx_display_list_free(ctxt);
+        return;
+    }
+    if (ctxt->display_list == NULL) {
+        ctxt->display_list = calloc(1, sizeof(struct gfx_display_list));
+    }
+    struct gfx_display_list *list = ctxt->display_list;
+    list->pool = pool;
+    list->stage = stage_policy_create("render", pool);
+    // a band is a large amount of work, even a few are worth sharing
+    list->stage.inline_threshold = 2;
+    list->stage.chunk = 1;
+}
+
+static void gfx_display_list_free(struct gfx_context_t *ctxt) {
+    struct gfx_display_list *list = ctxt->display_list;
+    if (list == NULL) {
+        return;
+    }
+    free(list->commands);
+    free(list->band_start);
+    free(list->band_cursor);
+    free(list->band_items);
+    free(list);
+    ctxt->display_list = NULL;
+}
+
+void gfx_draw_circle(struct gfx_context_t *ctxt, vec pos, double r,
+                     uint32_t color, double x0, double x1, double y0,
+                     double y1) {
+    int width = ctxt->width;
+    int height = ctxt->height;
+
+    int rescaled_x = (int)rescale_to_window(0, width, x0, x1, pos.x);
+    int rescaled_y = (int)rescale_to_window(0, height, y0, y1, pos.y);
+    int rescaled_radius = (int)rescale_to_window(0, width, x0, x1, r);
+
+    gfx_map(ctxt);
+    const gfx_sprite *sprite = gfx_sprite_get(ctxt, rescaled_radius);
+    if (ctxt->display_list != NULL) {
+        gfx_record(ctxt, (gfx_command){gfx_command_sprite, color, rescaled_x,
+                                       rescaled_y, 0, 0, sprite});
+        return;
+    }
+    gfx_target target = gfx_target_full(ctxt);
+    gfx_blit_sprite(&target, sprite, rescaled_x, rescaled_y, color);
+}
+
+extern void gfx_draw_line(struct gfx_context_t *ctxt, int x0, int x1, int y0,
+                          int y1, uint32_t color) {
+    if (ctxt->display_list != NULL) {
+        gfx_record(ctxt, (gfx_command){gfx_command_line, color, x0, y0, x1,
+                                       y1, NULL});
+        return;
     }
+    gfx_map(ctxt);
+    gfx_target target = gfx_target_full(ctxt);
+    gfx_line(&target, x0, x1, y0, y1, color);
+}
+
+static void gfx_draw_span(struct gfx_context_t *ctxt, int y, int xa, int xb,
+                          uint32_t color) {
+    if (ctxt->display_list != NULL) {
+        gfx_record(ctxt,
+                   (gfx_command){gfx_command_span, color, xa, y, xb, y, NULL});
+        return;
+    }
+    gfx_map(ctxt);
+    gfx_target target = gfx_target_full(ctxt);
+    gfx_hspan(&target, y, xa, xb, color);
 }
 
 extern void gfx_draw_triangle(struct gfx_context_t *ctxt, triangle t,
@@ -213,7 +1398,7 @@ extern void gfx_draw_triangle(struct gfx_context_t *ctxt, triangle t,
     int centroid_x = (int)rescale_to_window(0, width, x0, x1, centroid.x);
     int centroid_y = (int)rescale_to_window(0, height, y0, y1, centroid.y);
 
-    gfx_putpixel(ctxt, centroid_x, flip_vertical(centroid_y, height), color);
+    gfx_draw_span(ctxt, centroid_y, centroid_x, centroid_x, color);
 }
 
 void gfx_draw_dot(struct gfx_context_t *ctxt, vec pos, uint32_t color,
@@ -224,7 +1409,132 @@ void gfx_draw_dot(struct gfx_context_t *ctxt, vec pos, uint32_t color,
     int pos_x = (int)rescale_to_window(0, width, x0, x1, pos.x);
     int pos_y = (int)rescale_to_window(0, height, y0, y1, pos.y);
 
-    gfx_putpixel(ctxt, pos_x, flip_vertical(pos_y, height), color);
+    gfx_draw_span(ctxt, pos_y, pos_x, pos_x, color);
+}
+
+static uint32_t gfx_add_color(uint32_t pixel, uint32_t color) {
+    uint32_t r = COLOR_GET_R(pixel) + COLOR_GET_R(color);
+    uint32_t g = COLOR_GET_G(pixel) + COLOR_GET_G(color);
+    uint32_t b = COLOR_GET_B(pixel) + COLOR_GET_B(color);
+    r = r < 255 ? r : 255;
+    g = g < 255 ? g : 255;
+    b = b < 255 ? b : 255;
+    return MAKE_COLOR(r, g, b);
+}
+
+/// Add the color of many dots to the pixels under them, so that they get
+/// brighter where they pile up. The primitives recorded so far are
+/// rasterized first, the dots being drawn right away. The positions are
+/// mapped to pixels by chunks, in a loop the compiler vectorizes, then the
+/// colors are added one pixel after the other. The damage is marked once,
+/// as the rectangle around all the dots.
+/// @param ctxt Graphic context.
+/// @param dots The dots, in a periodic world.
+/// @param color Color of a dot of weight 1.
+/// @param x0 Left of the part of the world shown.
+/// @param x1 Right of the part of the world shown.
+/// @param y0 Bottom of the part of the world shown.
+/// @param y1 Top of the part of the world shown.
+/// @param period_x Width of the world, a dot is drawn at its image to the
+/// right of x0.
+/// @param period_y Height of the world.
+void gfx_add_dots(struct gfx_context_t *ctxt, const gfx_dots *dots,
+                  uint32_t color, double x0, double x1, double y0, double y1,
+                  double period_x, double period_y) {
+    gfx_flush(ctxt);
+    gfx_map(ctxt);
+    gfx_target target = gfx_target_full(ctxt);
+    int width = ctxt->width;
+    int height = ctxt->height;
+    int stride = ctxt->stride;
+    float scale_x = (float)(width / (x1 - x0));
+    float scale_y = (float)(height / (y1 - y0));
+    float px = (float)period_x;
+    float py = (float)period_y;
+    float fx0 = (float)x0;
+    float fy0 = (float)y0;
+    float lag = dots->lag;
+    float level_scale = 256.0f * dots->weight_scale;
+
+    // color added by a dot of each level
+    uint32_t shades[257];
+    for (uint32_t level = 0; level <= 256; ++level) {
+        uint32_t r = (COLOR_GET_R(color) * level) >> 8;
+        uint32_t g = (COLOR_GET_G(color) * level) >> 8;
+        uint32_t b = (COLOR_GET_B(color) * level) >> 8;
+        shades[level] = MAKE_COLOR(r, g, b);
+    }
+
+    int col_min = INT_MAX;
+    int col_max = INT_MIN;
+    int row_min = INT_MAX;
+    int row_max = INT_MIN;
+    int cols[GFX_DOTS_CHUNK];
+    int rows[GFX_DOTS_CHUNK];
+    int levels[GFX_DOTS_CHUNK];
+    for (int begin = 0; begin < dots->length; begin += GFX_DOTS_CHUNK) {
+        int n = dots->length - begin;
+        n = n < GFX_DOTS_CHUNK ? n : GFX_DOTS_CHUNK;
+        const float *restrict x = dots->x + begin;
+        const float *restrict y = dots->y + begin;
+        const float *restrict vx = dots->vx + begin;
+        const float *restrict vy = dots->vy + begin;
+        const float *restrict weight = dots->weight + begin;
+        for (int i = 0; i < n; ++i) {
+            float u = x[i] + lag * vx[i] - fx0;
+            float v = y[i] + lag * vy[i] - fy0;
+            // u in (-px, 2 px): shifts selected on u rather than positions,
+            // for the vectorizer
+            float u_right = u < 0.0f ? px : 0.0f;
+            float u_left = u >= px ? px : 0.0f;
+            float v_up = v < 0.0f ? py : 0.0f;
+            float v_down = v >= py ? py : 0.0f;
+            int col = (int)((u + u_right - u_left) * scale_x);
+            int row = height - (int)((v + v_up - v_down) * scale_y);
+            int level = (int)(level_scale * weight[i]);
+            level = level < 256 ? level : 256;
+            // row height is flipped just outside of the frame
+            int inside =
+                (col < width) & (row > 0) & (row < height) & (level > 0);
+            cols[i] = inside ? col : -1;
+            rows[i] = row;
+            levels[i] = level;
+        }
+        for (int i = 0; i < n; ++i) {
+            int col = cols[i];
+            if (col < 0) {
+                continue;
+            }
+            int row = rows[i];
+            uint32_t *p = target.pixels + row * stride + col;
+            *p = gfx_add_color(*p, shades[levels[i]]);
+            // utils min and max are on doubles
+            col_min = col < col_min ? col : col_min;
+            col_max = col > col_max ? col : col_max;
+            row_min = row < row_min ? row : row_min;
+            row_max = row > row_max ? row : row_max;
+        }
+    }
+    for (int row = row_min; row <= row_max; ++row) {
+        gfx_damage_mark(&target, row, col_min, col_max);
+    }
+}
+
+/// Fill a rectangle of the frame, in pixels.
+/// @param ctxt Graphic context.
+/// @param x X coordinate of its left column.
+/// @param y Y coordinate of its bottom row, from the bottom of the frame.
+/// @param width Width of the rectangle, clipped to the frame.
+/// @param height Height of the rectangle, clipped to the frame.
+/// @param color Color of the rectangle.
+void gfx_fill_rect(struct gfx_context_t *ctxt, int x, int y, int width,
+                   int height, uint32_t color) {
+    int x_end = (int)min(x + width, ctxt->width);
+    int y_end = (int)min(y + height, ctxt->height);
+    x = (int)max(x, 0);
+    for (int row = (int)max(y, 0); row < y_end && x < x_end; ++row) {
+        gfx_draw_span(ctxt, row, x, x_end - 1, color);
+    }
 }
 
 actions gfx_interpret_key(SDL_Keycode key) {
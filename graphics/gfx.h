@@ -3,10 +3,14 @@
 
 #include "../geom/triangle.h"
 #include "../geom/vec.h"
+#include "../threads/stage_policy.h"
+#include "../threads/worker_pool.h"
 #include "actions.h"
+#include "frame_dump.h"
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #define MAKE_COLOR(r, g, b)                                                    \
     ((uint32_t)b | ((uint32_t)g << 8) | ((uint32_t)r << 16))
@@ -26,22 +30,73 @@ typedef unsigned int uint;
 typedef unsigned long ulong;
 typedef unsigned char uchar;
 
+struct gfx_sprite_cache;
+struct gfx_display_list;
+struct gfx_damage;
+struct gfx_presenter;
+
+// called for each key pressed (down) or released, age being the seconds the
+// event waited in the queue
+typedef void (*gfx_key_fn)(void *ctx, SDL_Keycode key, bool down, double age);
+
+// dots given as arrays, one per coordinate, drawn at x + lag * vx
+typedef struct gfx_dots {
+    const float *x;
+    const float *y;
+    const float *vx;
+    const float *vy;
+    const float *weight; // brightness is weight * weight_scale, up to 1
+    float weight_scale;
+    float lag;
+    int length;
+} gfx_dots;
+
 struct gfx_context_t {
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
-    uint32_t *pixels;
-    int width;
+    uint32_t *pixels; // frame being drawn, NULL while the texture is unlocked
+    uint32_t *buffer; // frame copied to the texture when not streaming
+    int stride;       // pixels from one row of the frame to the next
+    bool streaming;   // drawing straight into the locked texture
+    bool headless;    // no window, renderer nor texture
+    bool wrap;        // primitives wrap around the edges instead of clipping
+    bool vsync;       // the renderer waits for the display refresh to present
+    frame_dump *dump; // where a headless context writes the frames presented
+    int width;        // size of the frame being drawn
     int height;
+    int tex_width;    // size of the texture, the frame is upscaled to it
+    int tex_height;
+    struct gfx_sprite_cache *sprites; // circle outlines already rasterized
+    struct gfx_display_list *display_list; // NULL when drawing right away
+    struct gfx_damage *damage; // parts of the frame to clear and upload
+    struct gfx_damage *shown;  // parts of the frame the texture shows
+    struct gfx_presenter *presenter; // NULL when presenting right away
 };
 
 extern void gfx_putpixel(struct gfx_context_t *ctxt, int x, int y,
                          uint32_t color);
 extern void gfx_clear(struct gfx_context_t *ctxt, uint32_t color);
 extern struct gfx_context_t *gfx_create(char *text, uint width, uint height);
+extern struct gfx_context_t *gfx_create_headless(uint width, uint height,
+                                                 frame_dump *dump);
 extern void gfx_destroy(struct gfx_context_t *ctxt);
 extern void gfx_present(struct gfx_context_t *ctxt);
-extern SDL_Keycode gfx_keypressed();
+extern void gfx_set_render_size(struct gfx_context_t *ctxt, int width,
+                                int height);
+extern void gfx_set_wrap(struct gfx_context_t *ctxt, bool wrap);
+extern void gfx_output_size(struct gfx_context_t *ctxt, int *width,
+                            int *height);
+extern bool gfx_set_vsync(struct gfx_context_t *ctxt, bool vsync);
+extern bool gfx_is_idle(struct gfx_context_t *ctxt);
+extern double gfx_refresh_rate(struct gfx_context_t *ctxt);
+extern void gfx_set_streaming(struct gfx_context_t *ctxt, bool streaming);
+extern void gfx_set_worker_pool(struct gfx_context_t *ctxt, worker_pool *pool);
+extern void gfx_flush(struct gfx_context_t *ctxt);
+extern bool gfx_start_present_thread(struct gfx_context_t *ctxt);
+extern void gfx_stop_present_thread(struct gfx_context_t *ctxt);
+extern void gfx_print_present_stats(struct gfx_context_t *ctxt, FILE *out);
+extern int gfx_poll_keys(gfx_key_fn on_key, void *ctx, bool *quit);
 extern void gfx_draw_circle(struct gfx_context_t *ctxt, vec pos, double r,
                             uint32_t color, double x0, double x1, double y0,
                             double y1);
@@ -52,6 +107,11 @@ extern void gfx_draw_triangle(struct gfx_context_t *ctxt, triangle t,
                               double y1);
 extern void gfx_draw_dot(struct gfx_context_t *ctxt, vec pos, uint32_t color,
                          double x0, double x1, double y0, double y1);
+extern void gfx_add_dots(struct gfx_context_t *ctxt, const gfx_dots *dots,
+                         uint32_t color, double x0, double x1, double y0,
+                         double y1, double period_x, double period_y);
+extern void gfx_fill_rect(struct gfx_context_t *ctxt, int x, int y, int width,
+                          int height, uint32_t color);
 extern actions gfx_interpret_key(SDL_Keycode key);
 
 #endif
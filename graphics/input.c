@@ -0,0 +1,129 @@
+#include "input.h"
+#include "gfx.h"
+#include <stdlib.h>
+#include <time.h>
+
+static double input_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+static unsigned input_bit(actions act) {
+    return ACTION_BIT(act);
+}
+
+static void input_push(input_state *in, actions act, double received) {
+    unsigned head = atomic_load_explicit(&in->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&in->tail, memory_order_acquire);
+    if (head - tail >= INPUT_RING_SIZE) {
+        // the key is still in the bitmap if it is held
+        in->dropped += 1;
+        return;
+    }
+    in->ring[head % INPUT_RING_SIZE] = (uint8_t)act;
+    in->ring_time[head % INPUT_RING_SIZE] = received;
+    atomic_store_explicit(&in->head, head + 1, memory_order_release);
+}
+
+static void input_on_key(void *ctx, SDL_Keycode key, bool down, double age) {
+    input_state *in = (input_state *)ctx;
+    actions act = gfx_interpret_key(key);
+    if (act == no_action || act == exit_game) {
+        return;
+    }
+    if (down) {
+        atomic_fetch_or_explicit(&in->held, input_bit(act),
+                                 memory_order_release);
+        input_push(in, act, input_now() - age);
+    } else {
+        atomic_fetch_and_explicit(&in->held, ~input_bit(act),
+                                  memory_order_release);
+    }
+}
+
+input_state *input_create() {
+    input_state *in = calloc(1, sizeof(input_state));
+    atomic_init(&in->held, 0);
+    atomic_init(&in->head, 0);
+    atomic_init(&in->tail, 0);
+    in->latency = latency_stats_create();
+    in->queue_latency = latency_stats_create();
+    in->frame_latency = latency_stats_create();
+    return in;
+}
+
+void input_poll(input_state *in, dyn_params *params) {
+    bool quit = false;
+    int events = gfx_poll_keys(input_on_key, in, &quit);
+    if (quit) {
+        write_game_ended(params, true);
+    }
+    in->events += (unsigned long)events;
+    in->frames += 1;
+    if (events > in->max_events_per_frame) {
+        in->max_events_per_frame = events;
+    }
+}
+
+unsigned input_actions(input_state *in) {
+    unsigned tail = atomic_load_explicit(&in->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&in->head, memory_order_acquire);
+    unsigned active = 0;
+    double now = tail != head ? input_now() : 0.0;
+    for (; tail != head; ++tail) {
+        active |= input_bit((actions)in->ring[tail % INPUT_RING_SIZE]);
+        if (in->num_pending < INPUT_RING_SIZE) {
+            in->received[in->num_pending] =
+                in->ring_time[tail % INPUT_RING_SIZE];
+            in->consumed[in->num_pending] = now;
+            in->num_pending += 1;
+        }
+    }
+    atomic_store_explicit(&in->tail, tail, memory_order_release);
+    active |= atomic_load_explicit(&in->held, memory_order_acquire);
+    return active;
+}
+
+void input_rendered(input_state *in) {
+    in->num_rendered = in->num_pending;
+}
+
+void input_presented(input_state *in) {
+    if (in->num_rendered == 0) {
+        return;
+    }
+    double now = input_now();
+    for (int i = 0; i < in->num_rendered; ++i) {
+        latency_stats_add(&in->latency, now - in->received[i]);
+        latency_stats_add(&in->queue_latency,
+                          in->consumed[i] - in->received[i]);
+        latency_stats_add(&in->frame_latency, now - in->consumed[i]);
+    }
+    // presses of the ticks run since the render wait for the next frame
+    int num_left = in->num_pending - in->num_rendered;
+    for (int i = 0; i < num_left; ++i) {
+        in->received[i] = in->received[in->num_rendered + i];
+        in->consumed[i] = in->consumed[in->num_rendered + i];
+    }
+    in->num_pending = num_left;
+    in->num_rendered = 0;
+}
+
+void input_print(input_state *in, FILE *out) {
+    fprintf(out,
+            "input: %lu key events over %lu frames, at most %d in a frame, "
+            "%lu presses dropped\n",
+            in->events, in->frames, in->max_events_per_frame, in->dropped);
+    latency_stats_print(&in->latency, "input to present latency", out);
+    latency_stats_print(&in->queue_latency, "  input to tick", out);
+    latency_stats_print(&in->frame_latency, "  tick to present", out);
+}
+
+void input_destroy(input_state **in) {
+    latency_stats_free(&(*in)->latency);
+    latency_stats_free(&(*in)->queue_latency);
+    latency_stats_free(&(*in)->frame_latency);
+    free(*in);
+    *in = NULL;
+}
@@ -0,0 +1,61 @@
+#ifndef _INPUT_H_
+#define _INPUT_H_
+
+#include "../geom/dyn_params.h"
+#include "actions.h"
+#include "latency_stats.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define INPUT_RING_SIZE 64
+
+// Keyboard state shared between the main thread, which drains the events of
+// the window every frame, and the simulation, which reads it once per tick:
+// the keys held are published as a bitmap of actions and the keys pressed
+// since the last tick go through a single producer, single consumer ring so
+// a press released before the next tick still acts for one tick. Each press
+// keeps the time it was received until the frame showing its effect is
+// presented, to measure the input to photon latency.
+typedef struct _input_state {
+    atomic_uint held;  // bit (1 << action) set while its key is down
+    atomic_uint head;  // presses pushed by the main thread
+    atomic_uint tail;  // presses consumed by the simulation
+    uint8_t ring[INPUT_RING_SIZE];
+    double ring_time[INPUT_RING_SIZE]; // when each press was received
+    // presses consumed by the ticks and not presented yet, written by the
+    // simulation during a tick and read by the main thread between ticks
+    double received[INPUT_RING_SIZE];
+    double consumed[INPUT_RING_SIZE];
+    int num_pending;
+    int num_rendered; // pending presses the last render shows
+    latency_stats latency;       // received to gfx_present returning
+    latency_stats queue_latency; // received to the tick consuming it
+    latency_stats frame_latency; // tick to gfx_present returning
+    unsigned long events;       // key events drained
+    unsigned long frames;       // polls
+    int max_events_per_frame;
+    unsigned long dropped;      // presses lost with the ring full
+} input_state;
+
+input_state *input_create();
+
+// main thread, once per frame: drains every pending event, ends the game on
+// escape or when the window is closed
+void input_poll(input_state *in, dyn_params *params);
+
+// simulation, once per tick: the actions of the player's vessel, a bitmap
+// of ACTION_BIT, from the keys held or pressed since the previous tick
+unsigned input_actions(input_state *in);
+
+// main thread, after a frame is rendered and after it is presented
+void input_rendered(input_state *in);
+
+void input_presented(input_state *in);
+
+void input_print(input_state *in, FILE *out);
+
+void input_destroy(input_state **in);
+
+#endif
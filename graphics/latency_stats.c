@@ -0,0 +1,69 @@
+#include "latency_stats.h"
+#include <math.h>
+#include <stdlib.h>
+
+static const int initial_capacity = 64;
+
+static int latency_stats_compare(const void *lhs, const void *rhs) {
+    double a = *(const double *)lhs;
+    double b = *(const double *)rhs;
+    return (a > b) - (a < b);
+}
+
+latency_stats latency_stats_create() {
+    latency_stats stats;
+    stats.samples = NULL;
+    stats.length = 0;
+    stats.capacity = 0;
+    stats.sorted = true;
+    return stats;
+}
+
+void latency_stats_add(latency_stats *stats, double seconds) {
+    if (stats->length == stats->capacity) {
+        int capacity =
+            stats->capacity > 0 ? 2 * stats->capacity : initial_capacity;
+        double *samples = realloc(stats->samples,
+                                  (size_t)capacity * sizeof(double));
+        if (samples == NULL) {
+            return;
+        }
+        stats->samples = samples;
+        stats->capacity = capacity;
+    }
+    stats->samples[stats->length++] = seconds;
+    stats->sorted = false;
+}
+
+double latency_stats_percentile(latency_stats *stats, double p) {
+    if (stats->length == 0) {
+        return 0.0;
+    }
+    if (!stats->sorted) {
+        qsort(stats->samples, (size_t)stats->length, sizeof(double),
+              latency_stats_compare);
+        stats->sorted = true;
+    }
+    int rank = (int)ceil(p * stats->length);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return stats->samples[rank > stats->length ? stats->length - 1 : rank - 1];
+}
+
+void latency_stats_print(latency_stats *stats, const char *name, FILE *out) {
+    if (stats->length == 0) {
+        fprintf(out, "%s: no sample\n", name);
+        return;
+    }
+    fprintf(out, "%s: %d samples, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+            name, stats->length,
+            1000.0 * latency_stats_percentile(stats, 0.5),
+            1000.0 * latency_stats_percentile(stats, 0.99),
+            1000.0 * latency_stats_percentile(stats, 1.0));
+}
+
+void latency_stats_free(latency_stats *stats) {
+    free(stats->samples);
+    *stats = latency_stats_create();
+}
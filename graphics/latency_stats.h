@@ -0,0 +1,27 @@
+#ifndef _LATENCY_STATS_H_
+#define _LATENCY_STATS_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Durations in seconds kept whole to give exact percentiles.
+typedef struct _latency_stats {
+    double *samples;
+    int length;
+    int capacity;
+    bool sorted;
+} latency_stats;
+
+latency_stats latency_stats_create();
+
+void latency_stats_add(latency_stats *stats, double seconds);
+
+// nearest rank percentile for p in [0, 1], 0 without samples
+double latency_stats_percentile(latency_stats *stats, double p);
+
+// one line with the p50, p99 and max in milliseconds
+void latency_stats_print(latency_stats *stats, const char *name, FILE *out);
+
+void latency_stats_free(latency_stats *stats);
+
+#endif
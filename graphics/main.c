@@ -1,13 +1,28 @@
+#include "../asteroids/asteroid_lod.h"
 #include "../asteroids/asteroids.h"
+#include "../asteroids/debris.h"
 #include "../c_vector/vector.h"
 #include "../geom/dyn_params.h"
 #include "../geom/utils.h"
 #include "../geom/vec.h"
+#include "../threads/affinity.h"
 #include "../threads/ast_params.h"
+#include "../threads/autotune.h"
 #include "../threads/bullets_params.h"
+#include "../threads/lock_prof.h"
+#include "../threads/worker_pool.h"
 #include "../vessel/vessel.h"
-#include "actions.h"
+#include "../vessel/vessel_batch.h"
+#include "camera.h"
+#include "density_lod.h"
+#include "fixed_step.h"
+#include "frame_budget.h"
+#include "frame_pacer.h"
 #include "gfx.h"
+#include "input.h"
+#include "present_bench.h"
+#include "render_options.h"
+#include "render_scale.h"
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -16,11 +31,15 @@
 
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 600
+#define FRAME_BUDGET (1.0 / 30.0)
+#define RENDER_BUDGET (1.0 / 120.0)
+// the vessel and the bullets threads both move the bullets each tick
+#define BULLET_MOVES_PER_TICK 2
 
 void *vessel_thread(void *arg) {
     vessel_params *v_b_params = (vessel_params *)arg;
     for (;;) {
-        pthread_mutex_lock(&v_b_params->mutex_v2);
+        PROF_MUTEX_LOCK(&v_b_params->mutex_v2, "vessel_mutex_v2");
         while (!v_b_params->finished) {
             pthread_cond_wait(&v_b_params->cond_start_io,
                               &v_b_params->mutex_v2);
@@ -29,28 +48,23 @@ void *vessel_thread(void *arg) {
         pthread_mutex_unlock(&v_b_params->mutex_v2);
 
         // vessel updates --> via le thread vessel
-        vessel_try_fire_bullet(v_b_params->v, v_b_params->bullet,
-                               v_b_params->params->bullet_try_fire,
-                               v_b_params->params->bullet_max_distance,
-                               v_b_params->params->bullet_vel,
-                               v_b_params->params->dt);
-        vessel_reset_acceleration(v_b_params->v);
-        vessel_update_acceleration_periodic(v_b_params->v,
-                                            v_b_params->params->vessel_ang_acc,
-                                            v_b_params->params->vessel_lin_acc);
-        vessel_move_periodic(
-            v_b_params->v, v_b_params->params->dt,
-            v_b_params->params->pos_min.x, v_b_params->params->pos_max.x,
-            v_b_params->params->pos_min.y, v_b_params->params->pos_max.y);
+        vessel_batch *vessels = v_b_params->vessels;
+        bullet_start_tick_all(v_b_params->bullet);
+        vessels->actions[0] = input_actions(v_b_params->input);
+        vessel_batch_bot_actions(vessels, 1, &v_b_params->params->clock);
+        vessel_batch_step(vessels, v_b_params->bullet, v_b_params->params);
         bullet_move_periodic_all(
             v_b_params->bullet, v_b_params->params->dt,
             v_b_params->params->pos_min.x, v_b_params->params->pos_max.x,
             v_b_params->params->pos_min.y, v_b_params->params->pos_max.y);
-        pthread_mutex_lock(&v_b_params->mutex_v1);
+        // read before signaling: once signaled, main may end the game in
+        // the next frame that this thread must still take part in
+        bool game_ended = read_game_ended(v_b_params->params);
+        PROF_MUTEX_LOCK(&v_b_params->mutex_v1, "vessel_mutex_v1");
         v_b_params->vessle_finish = true;
         pthread_cond_signal(&v_b_params->cond_v1);
         pthread_mutex_unlock(&v_b_params->mutex_v1);
-        if (read_game_ended(v_b_params->params)) {
+        if (game_ended) {
             break;
         }
     }
@@ -60,28 +74,26 @@ void *vessel_thread(void *arg) {
 void *ast_thread_fn(void *arg0) {
     ast_params *ap = (ast_params *)arg0;
     for (;;) {
-        asteroid_reset_acceleration_all(*ap->ast);
-        asteroid_update_acceleration_periodic_all(
-            *ap->ast, ap->dp->grav, ap->dp->repulse, ap->dp->pos_min.x,
-            ap->dp->pos_max.x, ap->dp->pos_min.y, ap->dp->pos_max.y);
+        ast_params_update_acceleration(ap);
 
-        pthread_mutex_lock(&ap->dp->mutex_render);
+        PROF_MUTEX_LOCK(&ap->dp->mutex_render, "mutex_render");
         while (!ap->dp->ast_render_finished) {
             pthread_cond_wait(&ap->dp->cond_render, &ap->dp->mutex_render);
         }
         ap->dp->ast_render_finished = false;
         pthread_mutex_unlock(&ap->dp->mutex_render);
 
-        asteroid_update_position_all_periodic(
-            *ap->ast, ap->dp->dt, ap->dp->pos_min.x, ap->dp->pos_max.x,
-            ap->dp->pos_min.y, ap->dp->pos_max.y);
+        ast_params_update_position(ap);
 
-        pthread_mutex_lock(&ap->dp->mutex_update);
+        bool game_ended = read_game_ended(ap->dp);
+        PROF_MUTEX_LOCK(&ap->dp->mutex_update, "mutex_update");
         ap->dp->counter_update += 1;
+        ap->reuse_far_forces = ap->dp->reuse_far_forces;
+        ap->lod.focus = ap->dp->lod_focus;
         pthread_cond_signal(&ap->dp->cond_update);
         pthread_mutex_unlock(&ap->dp->mutex_update);
 
-        if (read_game_ended(ap->dp)) {
+        if (game_ended) {
             break;
         }
     }
@@ -91,151 +103,488 @@ void *ast_thread_fn(void *arg0) {
 void *bullets_thread_fn(void *arg0) {
     bullets_params *bp = (bullets_params *)(arg0);
     for (;;) {
-        pthread_mutex_lock(&bp->dp->mutex_render);
+        PROF_MUTEX_LOCK(&bp->dp->mutex_render, "mutex_render");
         while (!bp->dp->blt_render_finished) {
             pthread_cond_wait(&bp->dp->cond_render, &bp->dp->mutex_render);
         }
         bp->dp->blt_render_finished = false;
         pthread_mutex_unlock(&bp->dp->mutex_render);
 
-        bullet_move_periodic_all(bp->bullets, bp->dp->dt, bp->dp->pos_min.x,
-                                 bp->dp->pos_max.x, bp->dp->pos_min.y,
-                                 bp->dp->pos_max.y);
+        bullets_params_move(bp);
         bullet_destroy_after_travel(bp->bullets);
 
-        pthread_mutex_lock(&bp->dp->mutex_update);
+        bool game_ended = read_game_ended(bp->dp);
+        PROF_MUTEX_LOCK(&bp->dp->mutex_update, "mutex_update");
         bp->dp->counter_update += 1;
         pthread_cond_signal(&bp->dp->cond_update);
         pthread_mutex_unlock(&bp->dp->mutex_update);
-        if (read_game_ended(bp->dp)) {
+        if (game_ended) {
             break;
         }
     }
     return NULL;
 }
 
+static vec asteroid_pos(const void *item) {
+    return ((const asteroid *)item)->pos;
+}
+
+static vec bullet_pos(const void *item) {
+    return ((const bullet *)item)->pos;
+}
+
+// how the entities are placed in the frame
+typedef struct render_view {
+    const camera *cam;
+    double alpha; // from the previous tick (0) to the last one (1)
+} render_view;
+
+// state between the previous tick and the last one
+static vec interpolate(vec prev, vec cur, double alpha) {
+    if (alpha >= 1.0) {
+        return cur;
+    }
+    return vec_add(prev, vec_scale(vec_sub(cur, prev), alpha));
+}
+
+static vec asteroid_image(const void *view, const void *item) {
+    const render_view *rv = view;
+    const asteroid *a = item;
+    return camera_image(rv->cam,
+                        interpolate(asteroid_prev_pos(a), a->pos, rv->alpha));
+}
+
+static vec bullet_image(const void *view, const void *item) {
+    const render_view *rv = view;
+    const bullet *b = item;
+    return camera_image(rv->cam,
+                        interpolate(bullet_prev_pos(b), b->pos, rv->alpha));
+}
+
+// what the particles of the debris are drawn with
+typedef struct debris_view {
+    struct gfx_context_t *context;
+    const debris *d;
+    float lag; // seconds from the last tick back to the state shown
+    double x0;
+    double x1;
+    double y0;
+    double y1;
+    const dyn_params *params;
+} debris_view;
+
+static void debris_image(void *ctx, int begin, int length) {
+    const debris_view *dv = ctx;
+    const debris *d = dv->d;
+    gfx_dots dots = {.x = d->x + begin,
+                     .y = d->y + begin,
+                     .vx = d->vx + begin,
+                     .vy = d->vy + begin,
+                     .weight = d->life + begin,
+                     .weight_scale = 1.0f / d->lifetime,
+                     .lag = dv->lag,
+                     .length = length};
+    double period_x = dv->params->pos_max.x - dv->params->pos_min.x;
+    double period_y = dv->params->pos_max.y - dv->params->pos_min.y;
+    gfx_add_dots(dv->context, &dots, MAKE_COLOR(160, 120, 80), dv->x0, dv->x1,
+                 dv->y0, dv->y1, period_x, period_y);
+}
+
+/// A vessel between its previous tick (alpha 0) and its last one (1).
+static vessel shown_vessel(const vessel *v, double alpha) {
+    vessel shown = *v;
+    shown.pos = interpolate(v->pos_t1, v->pos, alpha);
+    if (alpha < 1.0) {
+        shown.phi = v->phi_t1 + alpha * (v->phi - v->phi_t1);
+    }
+    return shown;
+}
+
+/// Draw a vessel, red while invincible, unless it lies out of the frame.
+static void draw_vessel(struct gfx_context_t *context, const camera *cam,
+                        const vessel *shown, const dyn_params *params,
+                        double x0, double x1, double y0, double y1) {
+    vec pos = camera_image(cam, shown->pos);
+    double margin = shown->base_length;
+    if (pos.x < x0 - margin || pos.x > x1 + margin || pos.y < y0 - margin ||
+        pos.y > y1 + margin) {
+        return;
+    }
+    uint32_t color = MAKE_COLOR(COLOR_WHITE, COLOR_WHITE, COLOR_WHITE);
+    if (vessel_is_invincible(shown, &params->clock)) {
+        color = MAKE_COLOR(COLOR_RED, COLOR_RED, COLOR_RED);
+    }
+    triangle t = vessel_to_triangle(shown);
+    t.v1 = camera_image(cam, t.v1);
+    t.v2 = camera_image(cam, t.v2);
+    t.v3 = camera_image(cam, t.v3);
+    gfx_draw_triangle(context, t, color, x0, x1, y0, y1);
+}
+
 /// Render some white noise.
 /// @param context graphical context to use.
-static void render(struct gfx_context_t *context, vector asteroids, vessel *v,
-                   vector bullets, double x0, double x1, double y0, double y1) {
+/// @param lod level of detail, to aggregate the crowded parts of the frame.
+/// @param cam camera, following the vessel when the world is larger than the
+/// frame.
+/// @param vessels the player's vessel, which the camera follows, and the
+/// bots, drawn under it.
+/// @param deb particles left by the destroyed asteroids, drawn under them.
+/// @param params parameters of the simulation.
+/// @param alpha where the state shown lies between the previous tick (0) and
+/// the last one (1).
+static void render(struct gfx_context_t *context, density_lod *lod,
+                   camera *cam, vector asteroids, vessel_batch *vessels,
+                   vector bullets, debris *deb, const dyn_params *params,
+                   double alpha) {
     gfx_clear(context, COLOR_BLACK);
 
+    vessel player = vessel_batch_get(vessels, 0, params);
+    vessel shown_player = shown_vessel(&player, alpha);
+    camera_follow(cam, shown_player.pos);
+    render_view view = {cam, alpha};
+    double x0, x1, y0, y1;
+    camera_view(cam, &x0, &x1, &y0, &y1);
+    float lag = (float)((alpha - 1.0) * params->dt);
+    debris_view dv = {context, deb, lag, x0, x1, y0, y1, params};
+    debris_draw(deb, debris_image, &dv);
+    // the entities are culled at the last tick and drawn up to a tick before
+    const camera_visible *shown_asteroids = camera_cull(
+        cam, camera_asteroids, &asteroids, asteroid_pos,
+        params->asteroid_radius + params->asteroid_max_vel * params->dt);
+    const camera_visible *shown_bullets =
+        camera_cull(cam, camera_bullets, &bullets, bullet_pos,
+                    BULLET_MOVES_PER_TICK * params->bullet_vel * params->dt);
+
+    int first_asteroid = 0;
+    int first_bullet = 0;
+    if (density_lod_begin(lod, context,
+                          shown_asteroids->length + shown_bullets->length, x0,
+                          x1, y0, y1)) {
+        first_asteroid =
+            density_lod_add(lod, shown_asteroids->items,
+                            shown_asteroids->length, asteroid_image, &view);
+        first_bullet = density_lod_add(lod, shown_bullets->items,
+                                       shown_bullets->length, bullet_image,
+                                       &view);
+        density_lod_end(lod, context);
+    }
+
     uint32_t color = MAKE_COLOR(COLOR_WHITE, COLOR_WHITE, COLOR_WHITE);
-    for (int i = 0; i < vector_length(&asteroids); i++) {
-        asteroid *ast = vector_get(&asteroids, i);
-        vec pos = ast->pos;
+    for (int i = 0; i < shown_asteroids->length; i++) {
+        if (!density_lod_is_sparse(lod, first_asteroid + i)) {
+            continue;
+        }
+        asteroid *ast = shown_asteroids->items[i];
+        vec pos = asteroid_image(&view, ast);
         double r = ast->r;
 
         gfx_draw_circle(context, pos, r, color, x0, x1, y0, y1);
     }
 
-    for (int i = 0; i < vector_length(&bullets); i++) {
-        bullet *b = vector_get(&bullets, i);
+    for (int i = 0; i < shown_bullets->length; i++) {
+        if (!density_lod_is_sparse(lod, first_bullet + i)) {
+            continue;
+        }
+        bullet *b = shown_bullets->items[i];
 
-        gfx_draw_dot(context, b->pos, color, x0, x1, y0, y1);
+        gfx_draw_dot(context, bullet_image(&view, b), color, x0, x1, y0, y1);
     }
 
-    if (vessel_is_invincible(v)) {
-        color = MAKE_COLOR(COLOR_RED, COLOR_RED, COLOR_RED);
+    for (int i = 1; i < vessels->length; i++) {
+        if (!vessel_batch_is_alive(vessels, i)) {
+            continue;
+        }
+        vessel bot = vessel_batch_get(vessels, i, params);
+        vessel shown_bot = shown_vessel(&bot, alpha);
+        draw_vessel(context, cam, &shown_bot, params, x0, x1, y0, y1);
     }
-    gfx_draw_triangle(context, vessel_to_triangle(v), color, x0, x1, y0, y1);
+    draw_vessel(context, cam, &shown_player, params, x0, x1, y0, y1);
 }
 
 /// Program entry point.
+/// @param argc number of command line arguments.
+/// @param argv command line arguments (see affinity.h, frame_budget.h,
+/// autotune.h, render_options.h, render_scale.h, density_lod.h, camera.h,
+/// fixed_step.h, frame_pacer.h, asteroid_lod.h, debris.h and vessel_batch.h
+/// for the options).
 /// @return the application status code (0 if success).
-int main() {
+int main(int argc, char **argv) {
+    lock_prof_init();
+
+    affinity_config affinity = affinity_config_create_default();
+    affinity_config_from_env(&affinity);
+    frame_budget budget = frame_budget_create(FRAME_BUDGET);
+    autotune_config autotune = autotune_config_create_default();
+    render_options render_opts = render_options_create_default();
+    render_scale scale = render_scale_create(RENDER_BUDGET);
+    density_lod lod = density_lod_create_default();
+    camera cam = camera_create_default();
+    fixed_step step = fixed_step_create_default();
+    frame_pacer pacer = frame_pacer_create_default();
+    asteroid_lod sim_lod = asteroid_lod_create_default();
+    debris deb = debris_create_default();
+    vessel_batch vessels = vessel_batch_create_default();
+    for (int i = 1; i < argc; ++i) {
+        if (!affinity_config_parse_arg(&affinity, argv[i]) &&
+            !frame_budget_parse_arg(&budget, argv[i]) &&
+            !autotune_parse_arg(&autotune, argv[i]) &&
+            !render_options_parse_arg(&render_opts, argv[i]) &&
+            !render_scale_parse_arg(&scale, argv[i]) &&
+            !density_lod_parse_arg(&lod, argv[i]) &&
+            !camera_parse_arg(&cam, argv[i]) &&
+            !fixed_step_parse_arg(&step, argv[i]) &&
+            !frame_pacer_parse_arg(&pacer, argv[i]) &&
+            !asteroid_lod_parse_arg(&sim_lod, argv[i]) &&
+            !debris_parse_arg(&deb, argv[i]) &&
+            !vessel_batch_parse_arg(&vessels, argv[i])) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+        }
+    }
+    if (render_opts.bench_frames > 0) {
+        worker_pool *pool =
+            render_opts.parallel
+                ? worker_pool_create(worker_pool_default_num_threads())
+                : NULL;
+        present_bench_run(stdout, render_opts.bench_frames, pool,
+                          render_opts.headless);
+        if (pool != NULL) {
+            worker_pool_destroy(&pool);
+        }
+        return EXIT_SUCCESS;
+    }
+    affinity_log_topology(&affinity);
+    // inherited by the threads created below
+    affinity_apply_memory_policy(&affinity);
 
-    struct gfx_context_t *ctxt =
-        gfx_create("Example", SCREEN_WIDTH, SCREEN_HEIGHT);
+    struct gfx_context_t *ctxt = NULL;
+    if (render_opts.headless) {
+        frame_dump *dump =
+            render_opts.dump_path == NULL
+                ? NULL
+                : frame_dump_open(render_opts.dump_format,
+                                  render_opts.dump_path, SCREEN_WIDTH,
+                                  SCREEN_HEIGHT);
+        if (render_opts.dump_path == NULL || dump != NULL) {
+            ctxt = gfx_create_headless(SCREEN_WIDTH, SCREEN_HEIGHT, dump);
+        }
+    } else {
+        ctxt = gfx_create("Example", SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
     if (!ctxt) {
         fprintf(stderr, "Graphics initialization failed!\n");
         return EXIT_FAILURE;
     }
 
     dyn_params params = dyn_params_create_default();
-    int num_asteroids = 4;
+    fixed_step_setup(&step, &params);
+    // without a display there is no real time to follow
+    step.lockstep = step.lockstep || render_opts.headless;
+    // as many asteroids per viewport in a larger world
+    int num_asteroids = (int)(4 * camera_setup(&cam, &params) + 0.5);
+    gfx_set_wrap(ctxt, !cam.enabled);
 
     vector ast = asteroid_create_random_non_overlaping_asteroids(
         params.asteroid_radius, params.asteroid_vel, params.asteroid_mass,
         params.asteroid_max_vel, params.dt, num_asteroids, params.pos_min.x,
         params.pos_max.x, params.pos_min.y, params.pos_max.y);
 
-    vessel v =
-        vessel_create(params.vessel_pos, params.vessel_base_length,
-                      params.vessel_mass, params.vessel_max_vel,
-                      params.vessel_max_ang_vel, params.vessel_remaining_lifes,
-                      params.vessel_inv_time, params.vessel_fire_cooldown_time);
+    // the player's vessel first, then the bots
+    if (vessel_batch_add(&vessels, params.vessel_pos,
+                         params.vessel_remaining_lifes, &params) < 0) {
+        fprintf(stderr, "Vessel allocation failed!\n");
+        gfx_destroy(ctxt);
+        return EXIT_FAILURE;
+    }
+    vessel_batch_add_bots(&vessels, params.vessel_remaining_lifes, &params);
+    params.lod_focus = vessel_batch_pos(&vessels, 0);
     vector bullets;
     vector_init(&bullets);
 
+    input_state *input = input_create();
     //--> initialise la strucuture contenan t les info pour le threads vessel
     vessel_params v_b_params =
-        create_thread_v_b_params(ctxt, &bullets, &v, &params);
+        create_thread_v_b_params(ctxt, &bullets, &vessels, &params, input);
+
+    worker_pool *pool = worker_pool_create(worker_pool_default_num_threads());
+    if (render_opts.parallel) {
+        gfx_set_worker_pool(ctxt, pool);
+        density_lod_set_pool(&lod, pool);
+    }
+    frame_pacer_setup(&pacer, ctxt);
+    gfx_set_streaming(ctxt, render_opts.streaming);
+    if (render_opts.async_present) {
+        gfx_start_present_thread(ctxt);
+    }
 
     pthread_t ast_thread = {0};
-    ast_params ap = ast_params_create(&ast, &bullets, &params);
+    ast_params ap = ast_params_create(&ast, &bullets, &params, pool);
+    autotune_result tuning = autotune_run(&autotune, &ap);
+    autotune_apply(&tuning, &ap);
+    // tuned on the full simulation, which the level of detail only lightens
+    ap.lod = sim_lod;
+    grid collision_grid =
+        grid_create(tuning.grid_cells, tuning.grid_cells, params.pos_min.x,
+                    params.pos_max.x, params.pos_min.y, params.pos_max.y);
     pthread_create(&ast_thread, NULL, ast_thread_fn, (void *)&ap);
 
     pthread_t bullets_thread = {0};
-    bullets_params bp = bullets_params_create(&bullets, &params);
+    bullets_params bp = bullets_params_create(&bullets, &params, pool);
     pthread_create(&bullets_thread, NULL, bullets_thread_fn, (void *)&bp);
 
     pthread_t vessel_threads;
     pthread_create(&vessel_threads, NULL, vessel_thread, (void *)&v_b_params);
-    
+
+    affinity_apply_workers(&affinity, pool);
+    affinity_apply_thread(&affinity, affinity_asteroids, ast_thread);
+    affinity_apply_thread(&affinity, affinity_bullets, bullets_thread);
+    affinity_apply_thread(&affinity, affinity_vessel, vessel_threads);
+    affinity_apply_thread(&affinity, affinity_render, pthread_self());
+    affinity_apply_sched_fifo(&affinity);
+
+    int num_frames = 0;
+    fixed_step_start(&step);
+    frame_pacer_start(&pacer);
     while (!params.game_ended) {
-        // vessel updates
-        pthread_mutex_lock(&v_b_params.mutex_v2);
-        v_b_params.finished = true;
-        actions_params_from_action(&params, gfx_interpret_key(gfx_keypressed()));
-        pthread_cond_signal(&v_b_params.cond_start_io);
-        pthread_mutex_unlock(&v_b_params.mutex_v2);
-    
-        pthread_mutex_lock(&params.mutex_render);
-        render(ctxt, ast, &v, bullets, params.pos_min.x, params.pos_max.x, params.pos_min.y, params.pos_max.y);
-        
-        pthread_mutex_lock(&v_b_params.mutex_v1);
-        while(!v_b_params.vessle_finish){
-            pthread_cond_wait(&v_b_params.cond_v1, &v_b_params.mutex_v1);
-        }
-        v_b_params.vessle_finish = false;
-        pthread_mutex_unlock(&v_b_params.mutex_v1);
-        
-        gfx_present(ctxt);
-    
-        asteroid_blown_by_bullets(&ast, &bullets, params.dt);
-        vessel_blown_by_asteroids(&v, ast);
-    
-        params.ast_render_finished = true;
-        params.blt_render_finished = true;
-    
-        pthread_cond_broadcast(&params.cond_render);
-        pthread_mutex_unlock(&params.mutex_render);
-    
-    
-        if (vector_length(&ast) == 0) {
-            printf("Game over: you won.\n");
-            write_game_ended(&params, true);
+        lock_prof_poll();
+        frame_budget_start(&budget);
+
+        input_poll(input, &params);
+        // decided once for the frame, so that its ticks are counted as one
+        bool reuse_far_forces = frame_budget_reuse_far_forces(&budget);
+
+        // once the game ended, the threads leave after the next tick
+        int ticks = fixed_step_advance(&step);
+        for (int tick = 0; tick < ticks; ++tick) {
+            // vessel updates
+            PROF_MUTEX_LOCK(&v_b_params.mutex_v2, "vessel_mutex_v2");
+            v_b_params.finished = true;
+            pthread_cond_signal(&v_b_params.cond_start_io);
+            pthread_mutex_unlock(&v_b_params.mutex_v2);
+
+            PROF_MUTEX_LOCK(&v_b_params.mutex_v1, "vessel_mutex_v1");
+            while (!v_b_params.vessle_finish) {
+                pthread_cond_wait(&v_b_params.cond_v1, &v_b_params.mutex_v1);
+            }
+            v_b_params.vessle_finish = false;
+            pthread_mutex_unlock(&v_b_params.mutex_v1);
+
+            PROF_MUTEX_LOCK(&params.mutex_render, "mutex_render");
+            asteroid_blown_by_bullets_grid(&ast, &bullets, params.dt,
+                                           params.asteroid_radius,
+                                           &collision_grid, &deb);
+            vessel_batch_blown_by_asteroids(&vessels, ast,
+                                            params.asteroid_radius,
+                                            &collision_grid, &params.clock);
+            debris_update(&deb, params.dt, params.pos_min.x,
+                          params.pos_max.x, params.pos_min.y,
+                          params.pos_max.y);
+
+            params.ast_render_finished = true;
+            params.blt_render_finished = true;
+
+            pthread_cond_broadcast(&params.cond_render);
+            pthread_mutex_unlock(&params.mutex_render);
+
+            if (vector_length(&ast) == 0) {
+                printf("Game over: you won.\n");
+                write_game_ended(&params, true);
+                break;
+            }
+
+            if (!vessel_batch_is_alive(&vessels, 0)) {
+                printf("Game over: you lost.\n");
+                write_game_ended(&params, true);
+                break;
+            }
+
+            PROF_MUTEX_LOCK(&params.mutex_update, "mutex_update");
+            while (params.counter_update != 2) {
+                pthread_cond_wait(&params.cond_update, &params.mutex_update);
+            }
+            params.counter_update = 0;
+            sim_clock_advance(&params.clock);
+            params.reuse_far_forces = reuse_far_forces;
+            params.lod_focus = vessel_batch_pos(&vessels, 0);
+            pthread_mutex_unlock(&params.mutex_update);
+
+            if (params.game_ended) {
+                break;
+            }
+        }
+        if (params.game_ended) {
             break;
         }
-    
-        if (v.remaining_lifes == 0) {
-            printf("Game over: you lost.\n");
+
+        // the threads only read the positions until the next tick
+        PROF_MUTEX_LOCK(&params.mutex_render, "mutex_render");
+        bool skip_render = frame_budget_skip_render(&budget);
+        if (!skip_render) {
+            int divisor = frame_budget_resolution_divisor(&budget);
+            int out_width, out_height;
+            gfx_output_size(ctxt, &out_width, &out_height);
+            gfx_set_render_size(
+                ctxt, render_scale_apply(&scale, out_width) / divisor,
+                render_scale_apply(&scale, out_height) / divisor);
+            render_scale_start(&scale);
+            render(ctxt, &lod, &cam, ast, &vessels, bullets, &deb, &params,
+                   fixed_step_alpha(&step));
+            gfx_flush(ctxt);
+            render_scale_finish(&scale);
+            input_rendered(input);
+        }
+        pthread_mutex_unlock(&params.mutex_render);
+        // before presenting, which may wait for the display to refresh
+        frame_budget_finish(&budget);
+
+        if (!skip_render) {
+            gfx_present(ctxt);
+            input_presented(input);
+        }
+
+        if (++num_frames == render_opts.max_frames) {
+            printf("Stopped after %d frames.\n", num_frames);
             write_game_ended(&params, true);
             break;
         }
-    
-        pthread_mutex_lock(&params.mutex_update);
-        while (params.counter_update != 2) {
-            pthread_cond_wait(&params.cond_update, &params.mutex_update);
-        }
-        params.counter_update = 0;
-        pthread_mutex_unlock(&params.mutex_update);
+
+        frame_pacer_wait(&pacer, ctxt);
     }
+    frame_budget_print(&budget, stdout);
+    fixed_step_print(&step, stdout);
+    frame_pacer_print(&pacer, stdout);
+    render_scale_print(&scale, stdout);
+    density_lod_print(&lod, stdout);
+    asteroid_lod_print(&ap.lod, stdout);
+    debris_print(&deb, stdout);
+    vessel_batch_print(&vessels, stdout);
+    camera_print(&cam, stdout);
+    input_print(input, stdout);
+    gfx_print_present_stats(ctxt, stdout);
     
+    // the threads may already wait for a frame that will not come
+    PROF_MUTEX_LOCK(&v_b_params.mutex_v2, "vessel_mutex_v2");
+    v_b_params.finished = true;
+    pthread_cond_signal(&v_b_params.cond_start_io);
+    pthread_mutex_unlock(&v_b_params.mutex_v2);
+
+    PROF_MUTEX_LOCK(&params.mutex_render, "mutex_render");
+    params.ast_render_finished = true;
+    params.blt_render_finished = true;
+    pthread_cond_broadcast(&params.cond_render);
+    pthread_mutex_unlock(&params.mutex_render);
+
     pthread_join(vessel_threads, NULL);
     pthread_join(ast_thread, NULL);
     pthread_join(bullets_thread, NULL);
+    gfx_set_worker_pool(ctxt, NULL);
+    density_lod_free(&lod);
+    asteroid_lod_free(&ap.lod);
+    debris_free(&deb);
+    vessel_batch_free(&vessels);
+    camera_free(&cam);
+    input_destroy(&input);
+    worker_pool_destroy(&pool);
+    grid_free(&collision_grid);
 
     vector_free(&ast);
     vector_free(&bullets);
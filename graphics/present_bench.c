@@ -0,0 +1,83 @@
+#include "present_bench.h"
+#include "../geom/vec.h"
+#include "gfx.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const int resolutions[][2] = {
+    {640, 480}, {800, 600}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+static const int num_resolutions = 5;
+static const int num_circles = 64;
+static const unsigned int scene_seed = 4242;
+
+static double present_bench_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+static double present_bench_rand(unsigned int *seed) {
+    return (double)rand_r(seed) / RAND_MAX;
+}
+
+// seconds per frame spent drawing and presenting
+static void present_bench_path(struct gfx_context_t *ctxt, bool streaming,
+                               int num_frames, double *draw, double *present) {
+    gfx_set_streaming(ctxt, streaming);
+    unsigned int seed = scene_seed;
+    uint32_t color = MAKE_COLOR(COLOR_WHITE, COLOR_WHITE, COLOR_WHITE);
+    *draw = 0.0;
+    *present = 0.0;
+    for (int frame = 0; frame < num_frames; ++frame) {
+        double start = present_bench_now();
+        gfx_clear(ctxt, COLOR_BLACK);
+        for (int i = 0; i < num_circles; ++i) {
+            vec pos = vec_create(present_bench_rand(&seed),
+                                 present_bench_rand(&seed));
+            gfx_draw_circle(ctxt, pos, 0.025 * (1 + i % 2), color, 0.0, 1.0,
+                            0.0, 1.0);
+        }
+        gfx_flush(ctxt);
+        double drawn = present_bench_now();
+        gfx_present(ctxt);
+        double presented = present_bench_now();
+        *draw += drawn - start;
+        *present += presented - drawn;
+    }
+    *draw /= num_frames;
+    *present /= num_frames;
+}
+
+void present_bench_run(FILE *out, int num_frames, worker_pool *pool,
+                       bool headless) {
+    fprintf(out, "%-10s %-10s %10s %12s %10s\n", "resolution", "path",
+            "draw [ms]", "present [ms]", "total [ms]");
+    for (int i = 0; i < num_resolutions; ++i) {
+        int width = resolutions[i][0];
+        int height = resolutions[i][1];
+        struct gfx_context_t *ctxt =
+            headless ? gfx_create_headless((uint)width, (uint)height, NULL)
+                     : gfx_create("Benchmark", (uint)width, (uint)height);
+        if (!ctxt) {
+            fprintf(stderr, "Graphics initialization failed at %dx%d\n", width,
+                    height);
+            continue;
+        }
+        gfx_set_worker_pool(ctxt, pool);
+
+        for (int streaming = 0; streaming <= !headless; ++streaming) {
+            double draw, present;
+            present_bench_path(ctxt, streaming, num_frames, &draw, &present);
+            char resolution[32];
+            snprintf(resolution, sizeof(resolution), "%dx%d", width, height);
+            const char *path = streaming ? "streaming" : "copy";
+            fprintf(out, "%-10s %-10s %10.3f %12.3f %10.3f\n", resolution,
+                    headless ? "headless" : path, draw * 1000.0,
+                    present * 1000.0, (draw + present) * 1000.0);
+        }
+
+        gfx_set_worker_pool(ctxt, NULL);
+        gfx_destroy(ctxt);
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef _PRESENT_BENCH_H_
+#define _PRESENT_BENCH_H_
+
+#include "../threads/worker_pool.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// renders the same scene at a few resolutions, once copying a separate
+// buffer to the texture and once drawing straight into the locked texture,
+// and prints the time per frame of both paths. Headless, only the time to
+// rasterize the frames into the buffer is measured.
+void present_bench_run(FILE *out, int num_frames, worker_pool *pool,
+                       bool headless);
+
+#endif
@@ -0,0 +1,62 @@
+#include "render_options.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int default_bench_frames = 200;
+
+render_options render_options_create_default() {
+    render_options ro = (render_options){0};
+    ro.parallel = true;
+    ro.streaming = false;
+    ro.async_present = false;
+    ro.bench_frames = 0;
+    ro.headless = false;
+    ro.max_frames = 0;
+    ro.dump_path = NULL;
+    ro.dump_format = frame_dump_raw;
+    return ro;
+}
+
+bool render_options_parse_arg(render_options *ro, const char *arg) {
+    if (strcmp(arg, "--serial-render") == 0) {
+        ro->parallel = false;
+        return true;
+    }
+    if (strcmp(arg, "--streaming-texture") == 0) {
+        ro->streaming = true;
+        return true;
+    }
+    if (strcmp(arg, "--async-present") == 0) {
+        ro->async_present = true;
+        return true;
+    }
+    if (strcmp(arg, "--bench-present") == 0) {
+        ro->bench_frames = default_bench_frames;
+        return true;
+    }
+    if (strncmp(arg, "--bench-present=", 16) == 0) {
+        ro->bench_frames = atoi(arg + 16);
+        return true;
+    }
+    if (strcmp(arg, "--headless") == 0) {
+        ro->headless = true;
+        return true;
+    }
+    if (strncmp(arg, "--frames=", 9) == 0) {
+        ro->max_frames = atoi(arg + 9);
+        return true;
+    }
+    // only a headless context writes its frames
+    if (strncmp(arg, "--dump-raw=", 11) == 0) {
+        ro->dump_format = frame_dump_raw;
+    } else if (strncmp(arg, "--dump-y4m=", 11) == 0) {
+        ro->dump_format = frame_dump_y4m;
+    } else if (strncmp(arg, "--dump-ppm=", 11) == 0) {
+        ro->dump_format = frame_dump_ppm;
+    } else {
+        return false;
+    }
+    ro->dump_path = arg + 11;
+    ro->headless = true;
+    return true;
+}
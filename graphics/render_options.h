@@ -0,0 +1,25 @@
+#ifndef _RENDER_OPTIONS_H_
+#define _RENDER_OPTIONS_H_
+
+#include "frame_dump.h"
+#include <stdbool.h>
+
+typedef struct _render_options {
+    bool parallel;      // rasterize bands of the frame on the worker pool
+    bool streaming;     // draw straight into the locked texture
+    bool async_present; // present the frames on a thread of their own
+    int bench_frames;   // frames per path of the present benchmark, 0 to play
+    bool headless;      // render without a window
+    int max_frames;     // frames played before quitting, 0 for no limit
+    const char *dump_path; // where to write the frames, NULL for nowhere
+    frame_dump_format dump_format;
+} render_options;
+
+render_options render_options_create_default();
+
+// handles --serial-render, --streaming-texture, --async-present,
+// --bench-present[=frames], --headless, --frames=<n> and
+// --dump-{raw,y4m,ppm}=<path>, returns false if arg is not for the rendering
+bool render_options_parse_arg(render_options *ro, const char *arg);
+
+#endif
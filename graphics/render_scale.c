@@ -0,0 +1,109 @@
+#include "render_scale.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const double default_min_scale = 0.25;
+static const double default_max_scale = 1.0;
+// weight of the last frame in the moving average of the render time
+static const double smoothing = 0.2;
+// relative change of the scale below which it is left alone
+static const double hysteresis = 0.08;
+// frames measured at a new scale before moving it again
+static const int settle_frames = 10;
+
+static double clamp_scale(const render_scale *rs, double scale) {
+    if (scale < rs->min_scale) {
+        return rs->min_scale;
+    }
+    return scale > rs->max_scale ? rs->max_scale : scale;
+}
+
+render_scale render_scale_create(double budget) {
+    render_scale rs = (render_scale){0};
+    rs.budget = budget;
+    rs.min_scale = default_min_scale;
+    rs.max_scale = default_max_scale;
+    rs.scale = default_max_scale;
+    rs.render_time = 0.0;
+    rs.settle_frames = settle_frames;
+    clock_gettime(CLOCK_MONOTONIC, &rs.render_start);
+    return rs;
+}
+
+bool render_scale_parse_arg(render_scale *rs, const char *arg) {
+    if (strncmp(arg, "--render-budget-ms=", 19) == 0) {
+        rs->budget = atof(arg + 19) / 1000.0;
+        return true;
+    }
+    if (strncmp(arg, "--render-scale-min=", 19) == 0) {
+        rs->min_scale = atof(arg + 19);
+    } else if (strncmp(arg, "--render-scale-max=", 19) == 0) {
+        rs->max_scale = atof(arg + 19);
+    } else {
+        return false;
+    }
+    if (rs->max_scale <= 0.0 || rs->max_scale > 1.0) {
+        rs->max_scale = default_max_scale;
+    }
+    if (rs->min_scale <= 0.0 || rs->min_scale > rs->max_scale) {
+        rs->min_scale = rs->max_scale;
+    }
+    rs->scale = rs->max_scale;
+    return true;
+}
+
+void render_scale_start(render_scale *rs) {
+    clock_gettime(CLOCK_MONOTONIC, &rs->render_start);
+}
+
+void render_scale_finish(render_scale *rs) {
+    struct timespec finish_time;
+    clock_gettime(CLOCK_MONOTONIC, &finish_time);
+
+    double elapsed = (double)(finish_time.tv_sec - rs->render_start.tv_sec);
+    elapsed += (double)(finish_time.tv_nsec - rs->render_start.tv_nsec) / 1000000000.0;
+    rs->frames += 1;
+    if (rs->render_time <= 0.0) {
+        rs->render_time = elapsed;
+    } else {
+        rs->render_time += smoothing * (elapsed - rs->render_time);
+    }
+    if (rs->budget <= 0.0 || rs->render_time <= 0.0) {
+        return;
+    }
+    if (rs->settle_frames > 0) {
+        rs->settle_frames -= 1;
+        return;
+    }
+
+    // the cost of a frame follows its number of pixels, so the square of
+    // the scale
+    double scale = clamp_scale(rs, rs->scale * sqrt(rs->budget /
+                                                    rs->render_time));
+    if (fabs(scale - rs->scale) < hysteresis * rs->scale) {
+        return;
+    }
+    if (scale > rs->scale) {
+        rs->increases += 1;
+    } else {
+        rs->decreases += 1;
+    }
+    // expected time at the new scale until it is measured
+    rs->render_time *= (scale * scale) / (rs->scale * rs->scale);
+    rs->scale = scale;
+    rs->settle_frames = settle_frames;
+}
+
+int render_scale_apply(const render_scale *rs, int size) {
+    int scaled = (int)(size * rs->scale + 0.5);
+    return scaled < 1 ? 1 : scaled;
+}
+
+void render_scale_print(const render_scale *rs, FILE *out) {
+    fprintf(out,
+            "render scale: %.2f (bounds %.2f-%.2f), average render: %.2f ms, "
+            "raised: %lu, lowered: %lu\n",
+            rs->scale, rs->min_scale, rs->max_scale, rs->render_time * 1000.0,
+            rs->increases, rs->decreases);
+}
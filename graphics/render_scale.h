@@ -0,0 +1,40 @@
+#ifndef _RENDER_SCALE_H_
+#define _RENDER_SCALE_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+// Scale of the internal framebuffer relative to the output, moved between
+// min_scale and max_scale so that the time spent rasterizing a frame stays
+// around the budget. The texture is stretched over the window at present.
+typedef struct _render_scale {
+    double budget;    // seconds of rendering per frame, 0 keeps the scale
+    double min_scale;
+    double max_scale;
+    double scale;
+    double render_time; // moving average of the measured render times
+    int settle_frames;  // frames left before the scale may move again
+    struct timespec render_start;
+    unsigned long frames;
+    unsigned long increases;
+    unsigned long decreases;
+} render_scale;
+
+render_scale render_scale_create(double budget);
+
+// handles --render-budget-ms=<ms>, --render-scale-min=<scale> and
+// --render-scale-max=<scale>, returns false if arg is not for the scale
+bool render_scale_parse_arg(render_scale *rs, const char *arg);
+
+void render_scale_start(render_scale *rs);
+
+// measures the rendering and picks the scale of the next frame
+void render_scale_finish(render_scale *rs);
+
+// number of pixels to render along an output side of the given size
+int render_scale_apply(const render_scale *rs, int size);
+
+void render_scale_print(const render_scale *rs, FILE *out);
+
+#endif
@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+static const char *role_names[affinity_num_roles] = {
+    "render", "vessel", "asteroids", "bullets", "workers"};
+
+static const char *role_env[affinity_num_roles] = {
+    "ASTEROIDS_CPUS_RENDER", "ASTEROIDS_CPUS_VESSEL",
+    "ASTEROIDS_CPUS_ASTEROIDS", "ASTEROIDS_CPUS_BULLETS",
+    "ASTEROIDS_CPUS_WORKERS"};
+
+static const int default_fifo_priority = 10;
+
+affinity_config affinity_config_create_default() {
+    affinity_config cfg = (affinity_config){0};
+    cfg.numa_local = false;
+    cfg.sched_fifo = false;
+    cfg.fifo_priority = default_fifo_priority;
+    return cfg;
+}
+
+// parses lists like "0,2,4-7"
+static bool affinity_parse_cpus(affinity_cpus *cpus, const char *list) {
+    affinity_cpus parsed = (affinity_cpus){0};
+    const char *c = list;
+    while (*c != '\0') {
+        char *end;
+        long first = strtol(c, &end, 10);
+        long last = first;
+        if (end == c || first < 0) {
+            return false;
+        }
+        if (*end == '-') {
+            c = end + 1;
+            last = strtol(c, &end, 10);
+            if (end == c || last < first) {
+                return false;
+            }
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            if (cpu >= AFFINITY_MAX_CPUS ||
+                parsed.num_cpus == AFFINITY_MAX_CPUS) {
+                return false;
+            }
+            parsed.cpus[parsed.num_cpus++] = (int)cpu;
+        }
+        if (*end == ',') {
+            end += 1;
+        } else if (*end != '\0') {
+            return false;
+        }
+        c = end;
+    }
+    *cpus = parsed;
+    return true;
+}
+
+static bool affinity_parse_bool(const char *value) {
+    return strcmp(value, "0") != 0 && strcmp(value, "false") != 0 &&
+           strcmp(value, "no") != 0 && strcmp(value, "off") != 0;
+}
+
+// sets the SCHED_FIFO priority from value, or warns and keeps the current
+// one if it is not a priority of the policy
+static void affinity_parse_priority(affinity_config *cfg, const char *value,
+                                    const char *source) {
+    char *end;
+    errno = 0;
+    long priority = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno != 0 ||
+        priority < sched_get_priority_min(SCHED_FIFO) ||
+        priority > sched_get_priority_max(SCHED_FIFO)) {
+        fprintf(stderr,
+                "affinity: invalid SCHED_FIFO priority in %s, keeping %d\n",
+                source, cfg->fifo_priority);
+        return;
+    }
+    cfg->fifo_priority = (int)priority;
+}
+
+void affinity_config_from_env(affinity_config *cfg) {
+    for (int role = 0; role < affinity_num_roles; ++role) {
+        const char *list = getenv(role_env[role]);
+        if (list != NULL && !affinity_parse_cpus(&cfg->roles[role], list)) {
+            fprintf(stderr, "affinity: ignoring %s=%s\n", role_env[role], list);
+        }
+    }
+    const char *numa_local = getenv("ASTEROIDS_NUMA_LOCAL");
+    if (numa_local != NULL) {
+        cfg->numa_local = affinity_parse_bool(numa_local);
+    }
+    const char *sched_fifo = getenv("ASTEROIDS_SCHED_FIFO");
+    if (sched_fifo != NULL) {
+        cfg->sched_fifo = affinity_parse_bool(sched_fifo);
+        // any other true value than a number keeps the default priority
+        if (cfg->sched_fifo && strcmp(sched_fifo, "true") != 0 &&
+            strcmp(sched_fifo, "yes") != 0 && strcmp(sched_fifo, "on") != 0) {
+            char source[64];
+            snprintf(source, sizeof(source), "ASTEROIDS_SCHED_FIFO=%s",
+                     sched_fifo);
+            affinity_parse_priority(cfg, sched_fifo, source);
+        }
+    }
+}
+
+bool affinity_config_parse_arg(affinity_config *cfg, const char *arg) {
+    for (int role = 0; role < affinity_num_roles; ++role) {
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "--cpus-%s=", role_names[role]);
+        if (strncmp(arg, prefix, strlen(prefix)) == 0) {
+            if (!affinity_parse_cpus(&cfg->roles[role], arg + strlen(prefix))) {
+                fprintf(stderr, "affinity: invalid cpu list in %s\n", arg);
+            }
+            return true;
+        }
+    }
+    if (strcmp(arg, "--numa-local") == 0) {
+        cfg->numa_local = true;
+        return true;
+    }
+    if (strcmp(arg, "--sched-fifo") == 0) {
+        cfg->sched_fifo = true;
+        return true;
+    }
+    if (strncmp(arg, "--sched-fifo=", 13) == 0) {
+        cfg->sched_fifo = true;
+        affinity_parse_priority(cfg, arg + 13, arg);
+        return true;
+    }
+    return false;
+}
+
+// the cpu sets and the pinning are glibc extensions, the options are ignored
+// elsewhere
+#ifdef __linux__
+static void affinity_format_mask(const cpu_set_t *set, char *buf, size_t n) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int cpu = 0; cpu < CPU_SETSIZE && len + 16 < n; ++cpu) {
+        if (!CPU_ISSET((size_t)cpu, set)) {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE &&
+               CPU_ISSET((size_t)(last + 1), set)) {
+            last += 1;
+        }
+        if (last == cpu) {
+            len += (size_t)snprintf(buf + len, n - len, "%s%d",
+                                    len > 0 ? "," : "", cpu);
+        } else {
+            len += (size_t)snprintf(buf + len, n - len, "%s%d-%d",
+                                    len > 0 ? "," : "", cpu, last);
+        }
+        cpu = last;
+    }
+}
+
+static void affinity_pin(const char *name, pthread_t thread, const int *cpus,
+                         int num_cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < num_cpus; ++i) {
+        CPU_SET((size_t)cpus[i], &set);
+    }
+    int err = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &set);
+
+    char mask[256];
+    cpu_set_t applied;
+    if (pthread_getaffinity_np(thread, sizeof(cpu_set_t), &applied) == 0) {
+        affinity_format_mask(&applied, mask, sizeof(mask));
+    } else {
+        snprintf(mask, sizeof(mask), "unknown");
+    }
+    if (err != 0) {
+        printf("affinity: %s pinning failed (%s), running on cpus %s\n", name,
+               strerror(err), mask);
+    } else {
+        printf("affinity: %s pinned to cpus %s\n", name, mask);
+    }
+}
+#else
+static void affinity_pin(const char *name, pthread_t thread, const int *cpus,
+                         int num_cpus) {
+    (void)thread;
+    (void)cpus;
+    (void)num_cpus;
+    printf("affinity: pinning %s needs Linux, ignored\n", name);
+}
+#endif
+
+void affinity_apply_thread(const affinity_config *cfg, affinity_role role,
+                           pthread_t thread) {
+    const affinity_cpus *cpus = &cfg->roles[role];
+    if (cpus->num_cpus == 0) {
+        return;
+    }
+    affinity_pin(role_names[role], thread, cpus->cpus, cpus->num_cpus);
+}
+
+void affinity_apply_workers(const affinity_config *cfg, worker_pool *pool) {
+    const affinity_cpus *cpus = &cfg->roles[affinity_workers];
+    if (cpus->num_cpus == 0) {
+        return;
+    }
+#ifndef __linux__
+    printf("affinity: pinning workers needs Linux, ignored\n");
+    return;
+#endif
+    for (int i = 0; i < pool->num_threads; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "workers[%d]", i);
+        affinity_pin(name, pool->threads[i], &cpus->cpus[i % cpus->num_cpus],
+                     1);
+    }
+}
+
+void affinity_apply_memory_policy(const affinity_config *cfg) {
+    if (!cfg->numa_local) {
+        return;
+    }
+#ifndef __linux__
+    printf("affinity: numa-local allocation needs Linux, ignored\n");
+#elif defined(HAVE_LIBNUMA)
+    if (numa_available() < 0) {
+        printf("affinity: numa is not available on this host\n");
+        return;
+    }
+    const affinity_cpus *cpus = &cfg->roles[affinity_asteroids];
+    int node = cpus->num_cpus > 0 ? numa_node_of_cpu(cpus->cpus[0])
+                                  : numa_node_of_cpu(sched_getcpu());
+    if (node < 0) {
+        printf("affinity: could not find the numa node of the asteroids\n");
+        return;
+    }
+    numa_set_preferred(node);
+    printf("affinity: entity storage preferred on numa node %d\n", node);
+#else
+    printf("affinity: numa-local allocation needs libnuma, ignored\n");
+#endif
+}
+
+void affinity_apply_sched_fifo(const affinity_config *cfg) {
+    if (!cfg->sched_fifo) {
+        return;
+    }
+#ifdef __linux__
+    struct sched_param param = (struct sched_param){0};
+    param.sched_priority = cfg->fifo_priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+        printf("affinity: SCHED_FIFO %d for render failed (%s)\n",
+               cfg->fifo_priority, strerror(err));
+    } else {
+        printf("affinity: render runs SCHED_FIFO priority %d\n",
+               cfg->fifo_priority);
+    }
+#else
+    printf("affinity: SCHED_FIFO for render needs Linux, ignored\n");
+#endif
+}
+
+void affinity_log_topology(const affinity_config *cfg) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_nodes = 1;
+#ifdef HAVE_LIBNUMA
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+#endif
+    int num_pinned = 0;
+    for (int role = 0; role < affinity_num_roles; ++role) {
+        num_pinned += cfg->roles[role].num_cpus > 0 ? 1 : 0;
+    }
+    printf("affinity: %ld cpus online, %d numa node(s), %d role(s) pinned, "
+           "numa-local %s, SCHED_FIFO %s\n",
+           num_cpus, num_nodes, num_pinned, cfg->numa_local ? "on" : "off",
+           cfg->sched_fifo ? "on" : "off");
+}
@@ -0,0 +1,54 @@
+#ifndef TP_ASTEROIDS_AFFINITY_H
+#define TP_ASTEROIDS_AFFINITY_H
+
+#include "worker_pool.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+#define AFFINITY_MAX_CPUS 1024
+
+typedef enum {
+    affinity_render, // the thread driving the frames (main)
+    affinity_vessel,
+    affinity_asteroids,
+    affinity_bullets,
+    affinity_workers,
+    affinity_num_roles
+} affinity_role;
+
+typedef struct affinity_cpus {
+    int cpus[AFFINITY_MAX_CPUS];
+    int num_cpus; // 0 when the role is not pinned
+} affinity_cpus;
+
+typedef struct affinity_config {
+    affinity_cpus roles[affinity_num_roles];
+    bool numa_local; // entity storage on the node of the asteroids thread
+    bool sched_fifo; // real-time policy for the render thread
+    int fifo_priority;
+} affinity_config;
+
+affinity_config affinity_config_create_default();
+
+// reads ASTEROIDS_CPUS_<ROLE>, ASTEROIDS_NUMA_LOCAL and ASTEROIDS_SCHED_FIFO
+void affinity_config_from_env(affinity_config *cfg);
+
+// handles --cpus-<role>=<list>, --numa-local and --sched-fifo[=<priority>],
+// returns false if arg is not an affinity option
+bool affinity_config_parse_arg(affinity_config *cfg, const char *arg);
+
+// to be called by the threads allocating entities, before they do
+void affinity_apply_memory_policy(const affinity_config *cfg);
+
+void affinity_apply_thread(const affinity_config *cfg, affinity_role role,
+                           pthread_t thread);
+
+// workers are spread one per cpu of their list
+void affinity_apply_workers(const affinity_config *cfg, worker_pool *pool);
+
+// to be called by the render thread itself
+void affinity_apply_sched_fifo(const affinity_config *cfg);
+
+void affinity_log_topology(const affinity_config *cfg);
+
+#endif // TP_ASTEROIDS_AFFINITY_H
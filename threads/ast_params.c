@@ -1,6 +1,12 @@
 #include "ast_params.h"
+#include "../asteroids/asteroids.h"
 
-ast_params ast_params_create(vector *ast, vector *bullets, dyn_params *dp) {
+// ticks the far forces can be reused before they are computed again, even
+// while the frames stay over budget
+static const int far_refresh_ticks = 8;
+
+ast_params ast_params_create(vector *ast, vector *bullets, dyn_params *dp,
+                             worker_pool *pool) {
     ast_params params = (ast_params){0};
     params.ast = ast;
     params.bullets = bullets;
@@ -9,5 +15,122 @@ ast_params ast_params_create(vector *ast, vector *bullets, dyn_params *dp) {
     pthread_cond_init(&params.cond_update, NULL);
     // pthread_barrier_init(&params.barrier, NULL, 4);
     params.finished = false;
+    params.reuse_far_forces = false;
+    params.far_reused = false;
+    params.far_age = 0;
+    params.far_population = -1;
+    params.pool = pool;
+    params.acceleration_stage = stage_policy_create("acceleration", pool);
+    params.pairs_stage = stage_policy_create("acceleration pairs", NULL);
+    params.position_stage = stage_policy_create("position", pool);
+    params.lod = asteroid_lod_create_default();
     return params;
 }
+
+// every pair at once, whatever the range
+static void ast_params_acceleration_pairs(void *arg, int begin, int end) {
+    (void)begin;
+    (void)end;
+    ast_params *ap = (ast_params *)arg;
+    asteroid_update_acceleration_periodic_split_all(
+        *ap->ast, ap->dp->grav, ap->dp->repulse, ap->dp->far_distance,
+        ap->far_reused, ap->dp->pos_min.x, ap->dp->pos_max.x,
+        ap->dp->pos_min.y, ap->dp->pos_max.y);
+}
+
+static void ast_params_acceleration_range(void *arg, int begin, int end) {
+    ast_params *ap = (ast_params *)arg;
+    asteroid_update_acceleration_periodic_split_range(
+        *ap->ast, begin, end, ap->dp->grav, ap->dp->repulse,
+        ap->dp->far_distance, ap->far_reused, ap->dp->pos_min.x,
+        ap->dp->pos_max.x, ap->dp->pos_min.y, ap->dp->pos_max.y);
+}
+
+static void ast_params_acceleration_rows(void *arg, int begin, int end) {
+    ast_params *ap = (ast_params *)arg;
+    for (int i = begin; i < end; ++i) {
+        int ia = ap->lod.rows[i];
+        double nearest = asteroid_update_acceleration_periodic_split_row(
+            *ap->ast, ia, ap->dp->grav, ap->dp->repulse, ap->dp->far_distance,
+            false, ap->dp->pos_min.x, ap->dp->pos_max.x,
+            ap->dp->pos_min.y, ap->dp->pos_max.y);
+        asteroid_lod_after_row(&ap->lod,
+                               (asteroid *)vector_get(ap->ast, ia), nearest,
+                               ap->dp);
+    }
+}
+
+static void ast_params_position_range(void *arg, int begin, int end) {
+    ast_params *ap = (ast_params *)arg;
+    if (asteroid_lod_enabled(&ap->lod)) {
+        for (int ia = begin; ia < end; ++ia) {
+            asteroid_lod_update_position(
+                &ap->lod, (asteroid *)vector_get(ap->ast, ia), ap->dp);
+        }
+        return;
+    }
+    asteroid_update_position_periodic_range(
+        *ap->ast, begin, end, ap->dp->dt, ap->dp->pos_min.x, ap->dp->pos_max.x,
+        ap->dp->pos_min.y, ap->dp->pos_max.y);
+}
+
+// the far forces of every asteroid are reused if they were all computed
+// together less than far_refresh_ticks ago, and no asteroid appeared nor
+// vanished since: a new one has not computed them yet and, without a new
+// one, the population only shrinks. Otherwise they are computed this tick,
+// the positions saved to classify the pairs while they are reused.
+static bool ast_params_reuse_far(ast_params *ap) {
+    int length = vector_length(ap->ast);
+    bool reuse = ap->reuse_far_forces && ap->far_population == length &&
+                 ap->far_age < far_refresh_ticks;
+    for (int ia = 0; reuse && ia < length; ++ia) {
+        reuse = ((asteroid *)vector_get(ap->ast, ia))->far_computed;
+    }
+    if (reuse) {
+        ap->far_age += 1;
+        return true;
+    }
+    for (int ia = 0; ia < length; ++ia) {
+        asteroid *ast = (asteroid *)vector_get(ap->ast, ia);
+        ast->pos_far = ast->pos;
+        ast->far_computed = true;
+    }
+    ap->far_age = 0;
+    ap->far_population = length;
+    return false;
+}
+
+void ast_params_update_acceleration(ast_params *ap) {
+    if (asteroid_lod_enabled(&ap->lod)) {
+        int num_rows = asteroid_lod_build_rows(&ap->lod, ap->ast);
+        // with every asteroid active, the full pairs do less work
+        if (num_rows >= 0 && num_rows < vector_length(ap->ast)) {
+            // rows computed at different ticks share no refresh to reuse
+            ap->far_reused = false;
+            ap->far_population = -1;
+            stage_policy_run(&ap->acceleration_stage, ap->pool, num_rows,
+                             ast_params_acceleration_rows, (void *)ap);
+            return;
+        }
+    }
+    ap->far_reused = ast_params_reuse_far(ap);
+    int length = vector_length(ap->ast);
+    // alone, the symmetric pair loop does half the work of the rows. It is
+    // timed on its own so that the cost of a row, which decides how many
+    // threads share them, is only measured on rows; until it is, the rows
+    // run once.
+    const stage_policy *rows = &ap->acceleration_stage;
+    if ((rows->ns_per_item > 0.0 || rows->max_workers <= 1) &&
+        stage_policy_num_workers(rows, length) == 1) {
+        stage_policy_run(&ap->pairs_stage, NULL, length,
+                         ast_params_acceleration_pairs, (void *)ap);
+        return;
+    }
+    stage_policy_run(&ap->acceleration_stage, ap->pool, length,
+                     ast_params_acceleration_range, (void *)ap);
+}
+
+void ast_params_update_position(ast_params *ap) {
+    stage_policy_run(&ap->position_stage, ap->pool, vector_length(ap->ast),
+                     ast_params_position_range, (void *)ap);
+}
@@ -1,8 +1,11 @@
 #ifndef TP_ASTEROIDS_AST_PARAMS_H
 #define TP_ASTEROIDS_AST_PARAMS_H
 
+#include "../asteroids/asteroid_lod.h"
 #include "../c_vector/vector.h"
 #include "../geom/dyn_params.h"
+#include "stage_policy.h"
+#include "worker_pool.h"
 
 typedef struct ast_params {
     vector *ast;
@@ -12,8 +15,22 @@ typedef struct ast_params {
     pthread_cond_t cond_update;
     // pthread_barrier_t barrier;
     bool finished;
+    bool reuse_far_forces; // copy of dp->reuse_far_forces for this thread
+    bool far_reused;       // this tick, the far forces of the last refresh
+    int far_age;           // ticks the far forces were reused since then
+    int far_population;    // asteroids at the refresh, -1 for none
+    worker_pool *pool;
+    stage_policy acceleration_stage; // rows, shared by the workers
+    stage_policy pairs_stage;        // every pair, on the calling thread
+    stage_policy position_stage;
+    asteroid_lod lod; // focus copied from dp->lod_focus for this thread
 } ast_params;
 
-ast_params ast_params_create(vector *ast, vector *bullets, dyn_params *dp);
+ast_params ast_params_create(vector *ast, vector *bullets, dyn_params *dp,
+                             worker_pool *pool);
+
+void ast_params_update_acceleration(ast_params *ap);
+
+void ast_params_update_position(ast_params *ap);
 
 #endif // TP_ASTEROIDS_AST_PARAMS_H
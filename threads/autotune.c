@@ -0,0 +1,225 @@
+#include "autotune.h"
+#include "../asteroids/asteroids.h"
+#include "../geom/grid.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const int chunk_candidates[] = {0, 4, 16, 64};
+static const int num_chunk_candidates = 4;
+static const int max_grid_cells = 512;
+static const int num_repeats = 3;
+static const double slow_run = 0.05; // seconds, a single run is enough
+static const unsigned int probe_seed = 12345;
+
+static double autotune_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+autotune_config autotune_config_create_default() {
+    autotune_config cfg;
+    cfg.enabled = true;
+    cfg.cache_path = getenv("ASTEROIDS_AUTOTUNE_CACHE");
+    return cfg;
+}
+
+bool autotune_parse_arg(autotune_config *cfg, const char *arg) {
+    if (strcmp(arg, "--no-autotune") == 0) {
+        cfg->enabled = false;
+        return true;
+    }
+    if (strncmp(arg, "--autotune-cache=", 17) == 0) {
+        cfg->cache_path = arg + 17;
+        return true;
+    }
+    return false;
+}
+
+autotune_result autotune_default_result(const ast_params *ap) {
+    autotune_result res;
+    double cell_size = 2.0 * ap->dp->asteroid_radius;
+    res.grid_cells =
+        (int)floor((ap->dp->pos_max.x - ap->dp->pos_min.x) / cell_size);
+    res.grid_cells = res.grid_cells < 1 ? 1 : res.grid_cells;
+    res.chunk = 0;
+    res.num_workers = ap->acceleration_stage.max_workers;
+    return res;
+}
+
+static void autotune_cache_key(const ast_params *ap, char *key, size_t n) {
+    snprintf(key, n, "cpus=%ld asteroids=%d radius=%.6g box=%.6gx%.6g",
+             sysconf(_SC_NPROCESSORS_ONLN), vector_length(ap->ast),
+             ap->dp->asteroid_radius, ap->dp->pos_max.x - ap->dp->pos_min.x,
+             ap->dp->pos_max.y - ap->dp->pos_min.y);
+}
+
+static bool autotune_cache_read(const char *path, const char *key,
+                                autotune_result *res) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+    bool found = false;
+    char line[512];
+    size_t key_len = strlen(key);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        autotune_result cached;
+        if (strncmp(line, key, key_len) == 0 &&
+            sscanf(line + key_len, " -> grid=%d chunk=%d workers=%d",
+                   &cached.grid_cells, &cached.chunk,
+                   &cached.num_workers) == 3) {
+            *res = cached; // the last matching line wins
+            found = true;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static void autotune_cache_write(const char *path, const char *key,
+                                 const autotune_result *res) {
+    FILE *f = fopen(path, "a");
+    if (f == NULL) {
+        fprintf(stderr, "autotune: cannot write the cache %s\n", path);
+        return;
+    }
+    fprintf(f, "%s -> grid=%d chunk=%d workers=%d\n", key, res->grid_cells,
+            res->chunk, res->num_workers);
+    fclose(f);
+}
+
+static double autotune_time_acceleration(ast_params *ap, int num_workers,
+                                         int chunk) {
+    stage_policy saved = ap->acceleration_stage;
+    ap->acceleration_stage.max_workers = num_workers;
+    ap->acceleration_stage.chunk = chunk;
+    ap->acceleration_stage.min_ns_per_worker = 0.0;
+    ap->acceleration_stage.inline_threshold = 1;
+    ap->acceleration_stage.ns_per_item = 1.0;
+
+    double best = INFINITY;
+    for (int r = 0; r < num_repeats; ++r) {
+        double start = autotune_now();
+        ast_params_update_acceleration(ap);
+        double elapsed = autotune_now() - start;
+        best = elapsed < best ? elapsed : best;
+        if (elapsed > slow_run) {
+            break;
+        }
+    }
+    ap->acceleration_stage = saved;
+    return best;
+}
+
+static double autotune_time_collisions(ast_params *ap, const vec *probes,
+                                       int num_probes, int cells) {
+    grid g = grid_create(cells, cells, ap->dp->pos_min.x, ap->dp->pos_max.x,
+                         ap->dp->pos_min.y, ap->dp->pos_max.y);
+    double best = INFINITY;
+    for (int r = 0; r < num_repeats; ++r) {
+        double start = autotune_now();
+        asteroid_count_hits_grid(*ap->ast, probes, num_probes,
+                                 ap->dp->asteroid_radius, &g);
+        double elapsed = autotune_now() - start;
+        best = elapsed < best ? elapsed : best;
+        if (elapsed > slow_run) {
+            break;
+        }
+    }
+    grid_free(&g);
+    return best;
+}
+
+static autotune_result autotune_measure(ast_params *ap) {
+    autotune_result res = autotune_default_result(ap);
+
+    double best = INFINITY;
+    int max_workers = ap->acceleration_stage.max_workers;
+    for (int num_workers = 1; num_workers <= max_workers;) {
+        for (int c = 0; c < num_chunk_candidates; ++c) {
+            if (num_workers == 1 && c > 0) {
+                break; // the chunks do not matter alone
+            }
+            double t =
+                autotune_time_acceleration(ap, num_workers, chunk_candidates[c]);
+            if (t < best) {
+                best = t;
+                res.num_workers = num_workers;
+                res.chunk = chunk_candidates[c];
+            }
+        }
+        // powers of two, and max_workers itself
+        if (num_workers == max_workers) {
+            break;
+        }
+        num_workers = 2 * num_workers < max_workers ? 2 * num_workers
+                                                    : max_workers;
+    }
+
+    int num_asteroids = vector_length(ap->ast);
+    int num_probes = num_asteroids < 1024 ? 1024 : num_asteroids;
+    num_probes = num_probes > 100000 ? 100000 : num_probes;
+    vec *probes = malloc((size_t)num_probes * sizeof(vec));
+    unsigned int seed = probe_seed;
+    for (int i = 0; i < num_probes; ++i) {
+        double rx = (double)rand_r(&seed) / RAND_MAX;
+        double ry = (double)rand_r(&seed) / RAND_MAX;
+        probes[i] = vec_create(
+            ap->dp->pos_min.x + rx * (ap->dp->pos_max.x - ap->dp->pos_min.x),
+            ap->dp->pos_min.y + ry * (ap->dp->pos_max.y - ap->dp->pos_min.y));
+    }
+    int max_cells = 2 * (int)ceil(sqrt((double)num_asteroids)) + 1;
+    max_cells = max_cells > max_grid_cells ? max_grid_cells : max_cells;
+    best = INFINITY;
+    for (int cells = 1; cells <= max_cells; cells *= 2) {
+        double t = autotune_time_collisions(ap, probes, num_probes, cells);
+        if (t < best) {
+            best = t;
+            res.grid_cells = cells;
+        }
+    }
+    free(probes);
+    return res;
+}
+
+autotune_result autotune_run(const autotune_config *cfg, ast_params *ap) {
+    if (!cfg->enabled) {
+        autotune_result res = autotune_default_result(ap);
+        printf("autotune: skipped, grid %dx%d, chunk %d, %d worker(s)\n",
+               res.grid_cells, res.grid_cells, res.chunk, res.num_workers);
+        return res;
+    }
+
+    char key[256];
+    autotune_cache_key(ap, key, sizeof(key));
+    autotune_result res;
+    if (cfg->cache_path != NULL &&
+        autotune_cache_read(cfg->cache_path, key, &res)) {
+        printf("autotune: cached, grid %dx%d, chunk %d, %d worker(s)\n",
+               res.grid_cells, res.grid_cells, res.chunk, res.num_workers);
+        return res;
+    }
+
+    double start = autotune_now();
+    res = autotune_measure(ap);
+    printf("autotune: measured in %.0f ms, grid %dx%d, chunk %d, %d "
+           "worker(s)\n",
+           (autotune_now() - start) * 1000.0, res.grid_cells, res.grid_cells,
+           res.chunk, res.num_workers);
+    if (cfg->cache_path != NULL) {
+        autotune_cache_write(cfg->cache_path, key, &res);
+    }
+    return res;
+}
+
+void autotune_apply(const autotune_result *res, ast_params *ap) {
+    int max_workers = ap->pool != NULL ? ap->pool->num_threads + 1 : 1;
+    ap->acceleration_stage.max_workers =
+        res->num_workers < max_workers ? res->num_workers : max_workers;
+    ap->acceleration_stage.chunk = res->chunk;
+}
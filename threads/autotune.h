@@ -0,0 +1,35 @@
+#ifndef TP_ASTEROIDS_AUTOTUNE_H
+#define TP_ASTEROIDS_AUTOTUNE_H
+
+#include "ast_params.h"
+#include <stdbool.h>
+
+// Picks at startup the collision grid size, and the chunk size and number of
+// workers of the acceleration stage, by timing a few candidates on the actual
+// scene. Results can be cached in a file, keyed by the host and the scene.
+typedef struct autotune_config {
+    bool enabled;
+    const char *cache_path; // NULL for no cache
+} autotune_config;
+
+typedef struct autotune_result {
+    int grid_cells; // per axis
+    int chunk;      // 0 for automatic
+    int num_workers;
+} autotune_result;
+
+// reads ASTEROIDS_AUTOTUNE_CACHE
+autotune_config autotune_config_create_default();
+
+// handles --no-autotune and --autotune-cache=<path>, returns false if arg is
+// not an autotune option
+bool autotune_parse_arg(autotune_config *cfg, const char *arg);
+
+// what is used without calibration, deterministic
+autotune_result autotune_default_result(const ast_params *ap);
+
+autotune_result autotune_run(const autotune_config *cfg, ast_params *ap);
+
+void autotune_apply(const autotune_result *res, ast_params *ap);
+
+#endif // TP_ASTEROIDS_AUTOTUNE_H
@@ -1,6 +1,8 @@
 #include "bullets_params.h"
+#include "../vessel/bullet.h"
 
-bullets_params bullets_params_create(vector *bullets, dyn_params *dp) {
+bullets_params bullets_params_create(vector *bullets, dyn_params *dp,
+                                     worker_pool *pool) {
     bullets_params params = (bullets_params){0};
     params.bullets = bullets;
     params.dp = dp;
@@ -8,5 +10,19 @@ bullets_params bullets_params_create(vector *bullets, dyn_params *dp) {
     pthread_cond_init(&params.cond_update, NULL);
     // pthread_barrier_init(&params.barrier, NULL, 4);
     params.finished = false;
+    params.pool = pool;
+    params.move_stage = stage_policy_create("bullets", pool);
     return params;
 }
+
+static void bullets_params_move_range(void *arg, int begin, int end) {
+    bullets_params *bp = (bullets_params *)arg;
+    bullet_move_periodic_range(bp->bullets, begin, end, bp->dp->dt,
+                               bp->dp->pos_min.x, bp->dp->pos_max.x,
+                               bp->dp->pos_min.y, bp->dp->pos_max.y);
+}
+
+void bullets_params_move(bullets_params *bp) {
+    stage_policy_run(&bp->move_stage, bp->pool, vector_length(bp->bullets),
+                     bullets_params_move_range, (void *)bp);
+}
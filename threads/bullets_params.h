@@ -3,6 +3,8 @@
 
 #include "../c_vector/vector.h"
 #include "../geom/dyn_params.h"
+#include "stage_policy.h"
+#include "worker_pool.h"
 #include <pthread.h>
 #include <stdbool.h>
 
@@ -13,8 +15,13 @@ typedef struct bullets_params {
     pthread_cond_t cond_update;
     // pthread_barrier_t barrier;
     bool finished;
+    worker_pool *pool;
+    stage_policy move_stage;
 } bullets_params;
 
-bullets_params bullets_params_create(vector *bullets, dyn_params *dp);
+bullets_params bullets_params_create(vector *bullets, dyn_params *dp,
+                                     worker_pool *pool);
+
+void bullets_params_move(bullets_params *bp);
 
 #endif // TP_ASTEROIDS_BULLETS_PARAMS_H
@@ -0,0 +1,155 @@
+#include "lock_prof.h"
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct lock_prof_entry {
+    _Atomic(const char *) name;
+    atomic_ullong acquisitions;
+    atomic_ullong contended;
+    atomic_ullong wait_ns;
+    atomic_ullong max_wait_ns;
+    atomic_ullong histogram[LOCK_PROF_NUM_BUCKETS];
+} lock_prof_entry;
+
+static lock_prof_entry entries[LOCK_PROF_MAX_LOCKS];
+static atomic_int num_entries;
+static pthread_mutex_t mutex_entries = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t dump_requested = 0;
+
+static lock_prof_entry *lock_prof_find(const char *name) {
+    int n = atomic_load(&num_entries);
+    for (int i = 0; i < n; ++i) {
+        const char *entry_name = atomic_load(&entries[i].name);
+        if (entry_name == name || strcmp(entry_name, name) == 0) {
+            return &entries[i];
+        }
+    }
+
+    pthread_mutex_lock(&mutex_entries);
+    lock_prof_entry *entry = NULL;
+    n = atomic_load(&num_entries);
+    for (int i = 0; i < n && entry == NULL; ++i) {
+        if (strcmp(atomic_load(&entries[i].name), name) == 0) {
+            entry = &entries[i];
+        }
+    }
+    if (entry == NULL && n < LOCK_PROF_MAX_LOCKS) {
+        entry = &entries[n];
+        atomic_store(&entry->name, name);
+        atomic_store(&num_entries, n + 1);
+    }
+    pthread_mutex_unlock(&mutex_entries);
+    return entry;
+}
+
+static int lock_prof_bucket(uint64_t ns) {
+    int bucket = 0;
+    while (ns > 0 && bucket < LOCK_PROF_NUM_BUCKETS - 1) {
+        ns >>= 1;
+        bucket += 1;
+    }
+    return bucket;
+}
+
+int lock_prof_lock(pthread_mutex_t *mutex, const char *name) {
+    lock_prof_entry *entry = lock_prof_find(name);
+    if (pthread_mutex_trylock(mutex) == 0) {
+        if (entry != NULL) {
+            atomic_fetch_add(&entry->acquisitions, 1);
+            atomic_fetch_add(&entry->histogram[0], 1);
+        }
+        return 0;
+    }
+
+    struct timespec start_time, finish_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    int err = pthread_mutex_lock(mutex);
+    clock_gettime(CLOCK_MONOTONIC, &finish_time);
+    if (entry == NULL) {
+        return err;
+    }
+
+    uint64_t ns = (uint64_t)(finish_time.tv_sec - start_time.tv_sec) *
+                      1000000000ULL +
+                  (uint64_t)(finish_time.tv_nsec - start_time.tv_nsec);
+    atomic_fetch_add(&entry->acquisitions, 1);
+    atomic_fetch_add(&entry->contended, 1);
+    atomic_fetch_add(&entry->wait_ns, ns);
+    atomic_fetch_add(&entry->histogram[lock_prof_bucket(ns)], 1);
+    unsigned long long max_ns = atomic_load(&entry->max_wait_ns);
+    while (ns > max_ns &&
+           !atomic_compare_exchange_weak(&entry->max_wait_ns, &max_ns, ns)) {
+    }
+    return err;
+}
+
+#ifdef LOCK_PROFILING
+// upper bound of the bucket holding the given quantile of the waits
+static uint64_t lock_prof_quantile(const lock_prof_entry *entry,
+                                   unsigned long long contended, double q) {
+    unsigned long long rank = (unsigned long long)(q * contended);
+    unsigned long long seen = 0;
+    for (int i = 1; i < LOCK_PROF_NUM_BUCKETS; ++i) {
+        seen += atomic_load(&entry->histogram[i]);
+        if (seen > rank) {
+            return 1ULL << i;
+        }
+    }
+    return 1ULL << (LOCK_PROF_NUM_BUCKETS - 1);
+}
+#endif
+
+void lock_prof_dump(FILE *out) {
+#ifdef LOCK_PROFILING
+    fprintf(out, "%-20s %12s %12s %7s %12s %10s %10s %10s\n", "lock",
+            "acquired", "contended", "%", "wait (ms)", "p50 (us)", "p99 (us)",
+            "max (us)");
+    int n = atomic_load(&num_entries);
+    for (int i = 0; i < n; ++i) {
+        const lock_prof_entry *entry = &entries[i];
+        unsigned long long acquisitions = atomic_load(&entry->acquisitions);
+        unsigned long long contended = atomic_load(&entry->contended);
+        double percent =
+            acquisitions > 0 ? 100.0 * contended / acquisitions : 0.0;
+        fprintf(out, "%-20s %12llu %12llu %6.2f%% %12.3f %10.1f %10.1f %10.1f\n",
+                atomic_load(&entry->name), acquisitions, contended, percent,
+                atomic_load(&entry->wait_ns) / 1.0e6,
+                contended > 0 ? lock_prof_quantile(entry, contended, 0.5) / 1.0e3
+                              : 0.0,
+                contended > 0
+                    ? lock_prof_quantile(entry, contended, 0.99) / 1.0e3
+                    : 0.0,
+                atomic_load(&entry->max_wait_ns) / 1.0e3);
+    }
+#else
+    (void)out;
+#endif
+}
+
+#ifdef LOCK_PROFILING
+static void lock_prof_dump_at_exit() { lock_prof_dump(stderr); }
+
+static void lock_prof_on_signal(int sig) {
+    (void)sig;
+    dump_requested = 1;
+}
+#endif
+
+void lock_prof_init() {
+#ifdef LOCK_PROFILING
+    atexit(lock_prof_dump_at_exit);
+    signal(SIGUSR1, lock_prof_on_signal);
+#endif
+}
+
+void lock_prof_poll() {
+    if (dump_requested) {
+        dump_requested = 0;
+        lock_prof_dump(stderr);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef TP_ASTEROIDS_LOCK_PROF_H
+#define TP_ASTEROIDS_LOCK_PROF_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+// Lock contention profiler, compiled in with -DLOCK_PROFILING. Every
+// PROF_MUTEX_LOCK counts the acquisitions of the named lock, the ones that
+// had to wait, and a log2 histogram of the waiting time. The re-acquisition
+// inside pthread_cond_wait is not measured. Without LOCK_PROFILING the macro
+// is a plain pthread_mutex_lock.
+
+#ifdef LOCK_PROFILING
+#define PROF_MUTEX_LOCK(mutex, name) lock_prof_lock(mutex, name)
+#else
+#define PROF_MUTEX_LOCK(mutex, name) pthread_mutex_lock(mutex)
+#endif
+
+#define LOCK_PROF_MAX_LOCKS 32
+#define LOCK_PROF_NUM_BUCKETS 32 // bucket i: waits in [2^(i-1), 2^i) ns
+
+int lock_prof_lock(pthread_mutex_t *mutex, const char *name);
+
+// dumps at exit, and whenever lock_prof_poll runs after a SIGUSR1
+void lock_prof_init();
+
+void lock_prof_poll();
+
+void lock_prof_dump(FILE *out);
+
+#endif // TP_ASTEROIDS_LOCK_PROF_H
@@ -0,0 +1,66 @@
+#include "stage_policy.h"
+#include <time.h>
+
+static const double min_ns_per_worker = 50000.0;
+static const int inline_threshold = 64;
+static const double smoothing = 0.2;
+
+stage_policy stage_policy_create(const char *name, worker_pool *pool) {
+    stage_policy sp = (stage_policy){0};
+    sp.name = name;
+    sp.ns_per_item = 0.0;
+    sp.min_ns_per_worker = min_ns_per_worker;
+    sp.inline_threshold = inline_threshold;
+    sp.max_workers = pool != NULL ? pool->num_threads + 1 : 1;
+    sp.chunk = 0;
+    sp.last_workers = 1;
+    return sp;
+}
+
+int stage_policy_num_workers(const stage_policy *sp, int length) {
+    if (length < sp->inline_threshold || sp->max_workers <= 1) {
+        return 1;
+    }
+    // nothing measured yet: run inline once to get a first estimate
+    double work = sp->ns_per_item * length;
+    double num_workers = sp->min_ns_per_worker > 0.0
+                             ? work / sp->min_ns_per_worker
+                             : sp->max_workers;
+    if (num_workers > length / sp->inline_threshold) {
+        num_workers = length / sp->inline_threshold;
+    }
+    if (num_workers > sp->max_workers) {
+        num_workers = sp->max_workers;
+    }
+    return num_workers < 1.0 ? 1 : (int)num_workers;
+}
+
+void stage_policy_run(stage_policy *sp, worker_pool *pool, int length,
+                      worker_pool_fn fn, void *ctx) {
+    int num_workers = stage_policy_num_workers(sp, length);
+    struct timespec start_time, finish_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    if (pool == NULL || num_workers == 1) {
+        if (length > 0) {
+            fn(ctx, 0, length);
+        }
+    } else {
+        num_workers =
+            worker_pool_run(pool, num_workers, length, sp->chunk, fn, ctx);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finish_time);
+    double elapsed = (double)(finish_time.tv_sec - start_time.tv_sec) * 1.0e9;
+    elapsed += (double)(finish_time.tv_nsec - start_time.tv_nsec);
+
+    if (length > 0) {
+        double ns_per_item = elapsed * num_workers / length;
+        sp->ns_per_item = sp->ns_per_item == 0.0
+                              ? ns_per_item
+                              : (1.0 - smoothing) * sp->ns_per_item +
+                                    smoothing * ns_per_item;
+    }
+    sp->last_workers = num_workers;
+    sp->last_length = length;
+}
@@ -0,0 +1,27 @@
+#ifndef TP_ASTEROIDS_STAGE_POLICY_H
+#define TP_ASTEROIDS_STAGE_POLICY_H
+
+#include "worker_pool.h"
+
+// Decides how many threads join a stage from the measured cost of one item
+// and the number of items: a worker only joins if it gets at least
+// min_ns_per_worker of work, and small stages run inline on the caller.
+typedef struct stage_policy {
+    const char *name;
+    double ns_per_item; // moving average of the cpu time spent on one item
+    double min_ns_per_worker;
+    int inline_threshold; // below this many items no worker is woken up
+    int max_workers;      // caller included
+    int chunk;            // items taken at once by a worker, 0 for automatic
+    int last_workers;
+    int last_length;
+} stage_policy;
+
+stage_policy stage_policy_create(const char *name, worker_pool *pool);
+
+int stage_policy_num_workers(const stage_policy *sp, int length);
+
+void stage_policy_run(stage_policy *sp, worker_pool *pool, int length,
+                      worker_pool_fn fn, void *ctx);
+
+#endif // TP_ASTEROIDS_STAGE_POLICY_H
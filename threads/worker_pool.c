@@ -0,0 +1,144 @@
+#include "worker_pool.h"
+#include "lock_prof.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+static void worker_pool_consume(worker_pool *pool) {
+    for (;;) {
+        int begin = atomic_fetch_add(&pool->next, pool->chunk);
+        if (begin >= pool->length) {
+            return;
+        }
+        int end = begin + pool->chunk;
+        if (end > pool->length) {
+            end = pool->length;
+        }
+        pool->fn(pool->ctx, begin, end);
+    }
+}
+
+static void *worker_pool_thread_fn(void *arg) {
+    worker_pool *pool = (worker_pool *)arg;
+    unsigned long seen = 0;
+    int rank = -1;
+
+    PROF_MUTEX_LOCK(&pool->mutex, "worker_pool");
+    for (int i = 0; i < pool->num_threads; ++i) {
+        if (pthread_equal(pool->threads[i], pthread_self())) {
+            rank = i;
+        }
+    }
+    for (;;) {
+        while (!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->cond_start, &pool->mutex);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->generation;
+        if (rank >= pool->num_joining) {
+            continue;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+
+        worker_pool_consume(pool);
+
+        PROF_MUTEX_LOCK(&pool->mutex, "worker_pool");
+        pool->pending -= 1;
+        if (pool->pending == 0) {
+            pthread_cond_signal(&pool->cond_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+int worker_pool_default_num_threads() {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    // the thread submitting a stage always works on it too
+    return num_cpus > 1 ? (int)num_cpus - 1 : 0;
+}
+
+worker_pool *worker_pool_create(int num_threads) {
+    worker_pool *pool = calloc(1, sizeof(worker_pool));
+    pthread_mutex_init(&pool->mutex_submit, NULL);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond_start, NULL);
+    pthread_cond_init(&pool->cond_done, NULL);
+    pool->threads = calloc((size_t)(num_threads > 0 ? num_threads : 1),
+                           sizeof(pthread_t));
+    atomic_init(&pool->next, 0);
+
+    PROF_MUTEX_LOCK(&pool->mutex, "worker_pool");
+    for (int i = 0; i < num_threads; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, worker_pool_thread_fn,
+                           (void *)pool) != 0) {
+            break;
+        }
+        pool->num_threads += 1;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return pool;
+}
+
+int worker_pool_run(worker_pool *pool, int num_workers, int length, int chunk,
+                    worker_pool_fn fn, void *ctx) {
+    if (length <= 0) {
+        return 1;
+    }
+    int num_joining = num_workers - 1;
+    if (num_joining > pool->num_threads) {
+        num_joining = pool->num_threads;
+    }
+    if (num_joining <= 0 || pthread_mutex_trylock(&pool->mutex_submit) != 0) {
+        fn(ctx, 0, length);
+        return 1;
+    }
+    if (chunk <= 0) {
+        chunk = length / (4 * (num_joining + 1));
+    }
+    if (chunk <= 0) {
+        chunk = 1;
+    }
+
+    PROF_MUTEX_LOCK(&pool->mutex, "worker_pool");
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->length = length;
+    pool->chunk = chunk;
+    atomic_store(&pool->next, 0);
+    pool->num_joining = num_joining;
+    pool->pending = num_joining;
+    pool->generation += 1;
+    pthread_cond_broadcast(&pool->cond_start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    worker_pool_consume(pool);
+
+    PROF_MUTEX_LOCK(&pool->mutex, "worker_pool");
+    while (pool->pending != 0) {
+        pthread_cond_wait(&pool->cond_done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_mutex_unlock(&pool->mutex_submit);
+    return num_joining + 1;
+}
+
+void worker_pool_destroy(worker_pool **pool) {
+    PROF_MUTEX_LOCK(&(*pool)->mutex, "worker_pool");
+    (*pool)->stop = true;
+    pthread_cond_broadcast(&(*pool)->cond_start);
+    pthread_mutex_unlock(&(*pool)->mutex);
+
+    for (int i = 0; i < (*pool)->num_threads; ++i) {
+        pthread_join((*pool)->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&(*pool)->mutex_submit);
+    pthread_mutex_destroy(&(*pool)->mutex);
+    pthread_cond_destroy(&(*pool)->cond_start);
+    pthread_cond_destroy(&(*pool)->cond_done);
+    free((*pool)->threads);
+    free(*pool);
+    *pool = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef TP_ASTEROIDS_WORKER_POOL_H
+#define TP_ASTEROIDS_WORKER_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// processes the items [begin, end) of a stage
+typedef void (*worker_pool_fn)(void *ctx, int begin, int end);
+
+typedef struct worker_pool {
+    pthread_t *threads;
+    int num_threads;
+    pthread_mutex_t mutex_submit; // one stage at a time owns the pool
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_start;
+    pthread_cond_t cond_done;
+    unsigned long generation;
+    int num_joining; // workers taking part in the current stage
+    int pending;     // workers that did not finish the current stage yet
+    bool stop;
+    worker_pool_fn fn;
+    void *ctx;
+    int length;
+    int chunk;
+    atomic_int next;
+} worker_pool;
+
+worker_pool *worker_pool_create(int num_threads);
+
+int worker_pool_default_num_threads();
+
+// runs fn over [0, length) with num_workers threads (the caller included).
+// returns the number of threads that actually took part: if the pool is
+// already used by another stage the caller runs the stage alone.
+int worker_pool_run(worker_pool *pool, int num_workers, int length, int chunk,
+                    worker_pool_fn fn, void *ctx);
+
+void worker_pool_destroy(worker_pool **pool);
+
+#endif // TP_ASTEROIDS_WORKER_POOL_H
@@ -11,6 +11,7 @@ bullet *bullet_create(vec pos, vec vel, double max_distance) {
     b->vel = vel;
     b->pos_ini = pos;
     b->current_distance = 0.0;
+    b->distance_t1 = 0.0;
     b->max_distance = max_distance;
     return b;
 }
@@ -45,12 +46,35 @@ void bullet_move_all(vector *bullets, double dt) {
 
 void bullet_move_periodic_all(vector *bullets, double dt, double x0, double x1,
                               double y0, double y1) {
-    for (int i = 0; i < vector_length(bullets); ++i) {
+    bullet_move_periodic_range(bullets, 0, vector_length(bullets), dt, x0, x1,
+                               y0, y1);
+}
+
+void bullet_move_periodic_range(vector *bullets, int begin, int end, double dt,
+                                double x0, double x1, double y0, double y1) {
+    for (int i = begin; i < end; ++i) {
         bullet *b = vector_get(bullets, i);
         bullet_move_periodic(b, dt, x0, x1, y0, y1);
     }
 }
 
+void bullet_start_tick_all(vector *bullets) {
+    for (int i = 0; i < vector_length(bullets); ++i) {
+        bullet *b = vector_get(bullets, i);
+        b->distance_t1 = b->current_distance;
+    }
+}
+
+vec bullet_prev_pos(const bullet *const b) {
+    double speed = vec_norm(b->vel);
+    if (speed == 0.0) {
+        return b->pos;
+    }
+    return vec_sub(b->pos, vec_scale(b->vel, (b->current_distance -
+                                              b->distance_t1) /
+                                                 speed));
+}
+
 bool bullet_has_traveled_enough(const bullet *const b) {
     return b->current_distance > b->max_distance;
 }
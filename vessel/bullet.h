@@ -13,6 +13,7 @@ typedef struct _bullet {
     vec vel;
     vec pos_ini;
     double current_distance;
+    double distance_t1; // current_distance at the start of the tick
     double max_distance;
 } bullet;
 
@@ -33,6 +34,16 @@ void bullet_move_all(vector *bullets, double dt);
 void bullet_move_periodic_all(vector *bullets, double dt, double x0, double x1,
                               double y0, double y1);
 
+void bullet_move_periodic_range(vector *bullets, int begin, int end, double dt,
+                                double x0, double x1, double y0, double y1);
+
+// marks the start of a tick, which bullet_prev_pos goes back to however
+// many times the bullets move during it
+void bullet_start_tick_all(vector *bullets);
+
+// position at the start of the tick, not wrapped
+vec bullet_prev_pos(const bullet *const b);
+
 bool bullet_has_traveled_enough(const bullet *const b);
 
 void bullet_destroy_after_travel(vector *bullets);
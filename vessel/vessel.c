@@ -5,10 +5,12 @@
 #include <stdlib.h>
 #include <unistd.h>
 
-vessel vessel_create(vec pos, double base_length, double mass,double max_velocity, double max_ang_velocity, int remaining_lifes, double inv_time, double fire_cooldown_time) {
+vessel vessel_create(vec pos, double base_length, double mass,double max_velocity, double max_ang_velocity, int remaining_lifes, double inv_time, double fire_cooldown_time, const sim_clock *clock) {
     vessel v;
-    clock_gettime(CLOCK_MONOTONIC, &v.start_time);
-    v.last_fire_time = v.start_time;
+    v.inv_ticks = sim_clock_ticks(clock, inv_time);
+    v.fire_cooldown_ticks = sim_clock_ticks(clock, fire_cooldown_time);
+    v.invincible_until = clock->now + v.inv_ticks;
+    v.next_fire = clock->now + v.fire_cooldown_ticks;
     v.pos = pos;
     v.pos_t1 = v.pos;
     v.phi = 0.0;
@@ -18,14 +20,12 @@ vessel vessel_create(vec pos, double base_length, double mass,double max_velocit
     v.base_length = base_length;
     v.mass = mass;
     v.remaining_lifes = remaining_lifes;
-    v.inv_time = inv_time;
-    v.fire_cooldown_time = fire_cooldown_time;
     v.max_velocity = max_velocity;
     v.max_ang_velocity = max_ang_velocity;
     return v;
 }
 
-vessel_params create_thread_v_b_params(struct gfx_context_t *ctxt, vector *bullet, vessel *v, dyn_params *params){
+vessel_params create_thread_v_b_params(struct gfx_context_t *ctxt, vector *bullet, struct _vessel_batch *vessels, dyn_params *params, struct _input_state *input){
     vessel_params v_b_p;
     v_b_p.ctxt = ctxt;
     pthread_mutex_init(&v_b_p.mutex_v2, NULL);
@@ -34,7 +34,8 @@ vessel_params create_thread_v_b_params(struct gfx_context_t *ctxt, vector *bulle
     pthread_cond_init(&v_b_p.cond_start_io, NULL);
     v_b_p.bullet = bullet;
     v_b_p.params = params;
-    v_b_p.v = v;
+    v_b_p.vessels = vessels;
+    v_b_p.input = input;
     v_b_p.vessle_finish = false;
     v_b_p.finished = false;
     return v_b_p;
@@ -98,54 +99,49 @@ void vessel_move_periodic(vessel *v, double dt, double x0, double x1, double y0,
     vessel_make_periodic(v, x0, x1, y0, y1);
 }
 
-void vessel_blown(vessel *v) {
+void vessel_blown(vessel *v, const sim_clock *clock) {
     if (v->remaining_lifes == 0) {
         printf("We cannot blow a dead vessel");
         return;
     }
     
-    *v = vessel_create(v->pos, v->base_length, v->mass, v->max_velocity, v->max_ang_velocity, v->remaining_lifes - 1, v->inv_time, v->fire_cooldown_time);
+    // back at rest where it was blown, invincible and unable to fire for a while
+    v->remaining_lifes -= 1;
+    v->pos_t1 = v->pos;
+    v->phi = 0.0;
+    v->phi_t1 = v->phi;
+    vessel_reset_acceleration(v);
+    v->invincible_until = clock->now + v->inv_ticks;
+    v->next_fire = clock->now + v->fire_cooldown_ticks;
 }
 
 bool vessel_is_inside_asteroid(const vessel *const v, asteroid *ast) {
     return asteroid_is_inside(ast, v->pos);
 }
 
-void vessel_blown_by_asteroids(vessel *v, vector asteroids) {
+void vessel_blown_by_asteroids(vessel *v, vector asteroids, const sim_clock *clock) {
     
-    if (!vessel_is_invincible(v)) {
+    if (!vessel_is_invincible(v, clock)) {
         for (int i = 0; i < vector_length(&asteroids); ++i) {
             asteroid *ast = (asteroid *)vector_get(&asteroids, i);
             if (vessel_is_inside_asteroid(v, ast)) {
-                vessel_blown(v);
+                vessel_blown(v, clock);
                 return;
             }
         }
     }
 }
 
-bool vessel_is_invincible(vessel *v) {
-    struct timespec finish_time;
-    clock_gettime(CLOCK_MONOTONIC, &finish_time);
-    
-    double elapsed = (finish_time.tv_sec - v->start_time.tv_sec);
-    elapsed += (finish_time.tv_nsec - v->start_time.tv_nsec) / 1000000000.0;
-    
-    return (elapsed < v->inv_time);
+bool vessel_is_invincible(const vessel *const v, const sim_clock *clock) {
+    return !sim_clock_reached(clock, v->invincible_until);
 }
 
-bool vessel_can_fire(const vessel *const v) {
-    struct timespec finish_time;
-    clock_gettime(CLOCK_MONOTONIC, &finish_time);
-    
-    double elapsed = (finish_time.tv_sec - v->last_fire_time.tv_sec);
-    elapsed += (finish_time.tv_nsec - v->last_fire_time.tv_nsec) / 1000000000.0;
-    
-    return (elapsed > v->fire_cooldown_time);
+bool vessel_can_fire(const vessel *const v, const sim_clock *clock) {
+    return sim_clock_reached(clock, v->next_fire);
 }
 
-bullet *vessel_fire_bullet(vessel *v, double max_distance, double bullet_vel, double dt) {
-    if (vessel_can_fire(v)) {
+bullet *vessel_fire_bullet(vessel *v, double max_distance, double bullet_vel, double dt, const sim_clock *clock) {
+    if (vessel_can_fire(v, clock)) {
         vec dir = vec_rotate(tip, v->phi);
         vec bullet_pos =
                 vec_add(v->pos, vec_scale(dir, v->base_length)); // tip pos
@@ -155,7 +151,7 @@ bullet *vessel_fire_bullet(vessel *v, double max_distance, double bullet_vel, do
         double vel_proj = vec_scalar_product(vess_vel, dir);
         vec vel = vec_scale(dir, vel_proj + bullet_vel);
         
-        clock_gettime(CLOCK_MONOTONIC, &v->last_fire_time);
+        v->next_fire = clock->now + v->fire_cooldown_ticks;
         
         return bullet_create(bullet_pos, vel, max_distance);
     }
@@ -163,16 +159,6 @@ bullet *vessel_fire_bullet(vessel *v, double max_distance, double bullet_vel, do
     return NULL;
 }
 
-void vessel_try_fire_bullet(vessel *v, vector *bullets, bool bullet_try_fire, double bullet_max_distance, double bullet_vel, double dt) {
-    if (!bullet_try_fire) {
-        return;
-    }
-    bullet *b = vessel_fire_bullet(v, bullet_max_distance, bullet_vel, dt);
-    if (b != NULL) {
-        vector_push(bullets, b);
-    }
-}
-
 triangle vessel_to_triangle(const vessel *const v) {
     vec p1 =
             vec_add(v->pos, vec_scale(vec_rotate(tip, v->phi), v->base_length));
@@ -4,12 +4,12 @@
 #include "../asteroids/asteroids.h"
 #include "../c_vector/vector.h"
 #include "../geom/dyn_params.h"
+#include "../geom/sim_clock.h"
 #include "../geom/triangle.h"
 #include "../geom/vec.h"
 #include "bullet.h"
 #include <pthread.h>
 #include <stdbool.h>
-#include <time.h>
 
 // the vessel will have base "1" height "3/2" (in "base" units) and being
 // isocele. phi is the angle between the "height" and the horizontal axis. It is
@@ -28,10 +28,10 @@ typedef struct _vessel {
     double max_velocity;
     double max_ang_velocity;
     int remaining_lifes;
-    struct timespec start_time;
-    struct timespec last_fire_time;
-    double inv_time;
-    double fire_cooldown_time;
+    sim_tick inv_ticks;
+    sim_tick fire_cooldown_ticks;
+    sim_tick invincible_until; // first tick the vessel can be blown again
+    sim_tick next_fire;        // first tick the vessel can fire again
 } vessel;
 
 typedef struct _vessel_params{
@@ -43,20 +43,21 @@ typedef struct _vessel_params{
     bool vessle_finish;
     bool finished;
     vector *bullet;
-    vessel *v;
+    struct _vessel_batch *vessels; // the player's first
     dyn_params *params;
+    struct _input_state *input; // read at the start of each tick
 } vessel_params;
 
 static const vec tip = {.x = 0.0, .y = 1.0};
 static const vec left = {.x = -0.5, .y = -0.5};
 static const vec right = {.x = 0.5, .y = -0.5};
 
-vessel_params create_thread_v_b_params( struct gfx_context_t *ctxt , vector *bullet, vessel *v, dyn_params *params);
+vessel_params create_thread_v_b_params( struct gfx_context_t *ctxt , vector *bullet, struct _vessel_batch *vessels, dyn_params *params, struct _input_state *input);
 
 vessel vessel_create(vec pos, double base_length, double mass,
                      double max_velocity, double max_ang_velocity,
                      int remaining_lifes, double inv_time,
-                     double fire_cooldown_time);
+                     double fire_cooldown_time, const sim_clock *clock);
 
 void vessel_make_periodic(vessel *v, double x0, double x1, double y0,
                           double y1);
@@ -84,22 +85,19 @@ void vessel_update_position_periodic(vessel *v, double dt);
 void vessel_move_periodic(vessel *v, double dt, double x0, double x1, double y0,
                           double y1);
 
-void vessel_blown(vessel *v);
+void vessel_blown(vessel *v, const sim_clock *clock);
 
 bool vessel_is_inside_asteroid(const vessel *const v, asteroid *ast);
 
-void vessel_blown_by_asteroids(vessel *v, vector asteroids);
+void vessel_blown_by_asteroids(vessel *v, vector asteroids,
+                               const sim_clock *clock);
 
-bool vessel_is_invincible(vessel *v);
+bool vessel_is_invincible(const vessel *const v, const sim_clock *clock);
 
-bool vessel_can_fire(const vessel *const v);
+bool vessel_can_fire(const vessel *const v, const sim_clock *clock);
 
 bullet *vessel_fire_bullet(vessel *v, double max_distance, double bullet_vel,
-                           double dt);
-
-void vessel_try_fire_bullet(vessel *v, vector *bullets, bool bullet_try_fire,
-                            double bullet_max_distance, double bullet_vel,
-                            double dt);
+                           double dt, const sim_clock *clock);
 
 triangle vessel_to_triangle(const vessel *const v);
 
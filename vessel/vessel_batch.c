@@ -0,0 +1,332 @@
+#include "vessel_batch.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int default_think_ticks = 12;
+static const unsigned int bots_seed = 4242;
+
+vessel_batch vessel_batch_create_default() {
+    vessel_batch vb = (vessel_batch){0};
+    vb.num_bots = 0;
+    vb.think_ticks = default_think_ticks;
+    vb.seed = bots_seed;
+    return vb;
+}
+
+bool vessel_batch_parse_arg(vessel_batch *vb, const char *arg) {
+    if (strncmp(arg, "--bots=", 7) == 0) {
+        int num_bots = atoi(arg + 7);
+        vb->num_bots = num_bots < 0 ? 0 : num_bots;
+        return true;
+    }
+    if (strncmp(arg, "--bot-think=", 12) == 0) {
+        int think_ticks = atoi(arg + 12);
+        vb->think_ticks = think_ticks < 1 ? default_think_ticks : think_ticks;
+        return true;
+    }
+    return false;
+}
+
+static bool vessel_batch_grow_array(void **array, size_t size, int capacity) {
+    void *grown = realloc(*array, (size_t)capacity * size);
+    if (grown == NULL) {
+        return false;
+    }
+    *array = grown;
+    return true;
+}
+
+static bool vessel_batch_reserve(vessel_batch *vb, int length) {
+    if (length <= vb->capacity) {
+        return true;
+    }
+    int capacity = vb->capacity > 0 ? 2 * vb->capacity : 16;
+    capacity = capacity < length ? length : capacity;
+    // a failure leaves the arrays grown so far larger than needed, and valid
+    if (!vessel_batch_grow_array((void **)&vb->x, sizeof(double), capacity) ||
+        !vessel_batch_grow_array((void **)&vb->y, sizeof(double), capacity) ||
+        !vessel_batch_grow_array((void **)&vb->x_t1, sizeof(double),
+                                 capacity) ||
+        !vessel_batch_grow_array((void **)&vb->y_t1, sizeof(double),
+                                 capacity) ||
+        !vessel_batch_grow_array((void **)&vb->phi, sizeof(double), capacity) ||
+        !vessel_batch_grow_array((void **)&vb->phi_t1, sizeof(double),
+                                 capacity) ||
+        !vessel_batch_grow_array((void **)&vb->sin_phi, sizeof(double),
+                                 capacity) ||
+        !vessel_batch_grow_array((void **)&vb->cos_phi, sizeof(double),
+                                 capacity) ||
+        !vessel_batch_grow_array((void **)&vb->hits, sizeof(bool),
+                                 capacity) ||
+        !vessel_batch_grow_array((void **)&vb->remaining_lifes, sizeof(int),
+                                 capacity) ||
+        !vessel_batch_grow_array((void **)&vb->invincible_until,
+                                 sizeof(sim_tick), capacity) ||
+        !vessel_batch_grow_array((void **)&vb->next_fire, sizeof(sim_tick),
+                                 capacity) ||
+        !vessel_batch_grow_array((void **)&vb->actions, sizeof(unsigned),
+                                 capacity)) {
+        return false;
+    }
+    vb->capacity = capacity;
+    return true;
+}
+
+int vessel_batch_add(vessel_batch *vb, vec pos, int remaining_lifes,
+                     const dyn_params *params) {
+    if (!vessel_batch_reserve(vb, vb->length + 1)) {
+        return -1;
+    }
+    const sim_clock *clock = &params->clock;
+    vb->inv_ticks = sim_clock_ticks(clock, params->vessel_inv_time);
+    vb->fire_cooldown_ticks =
+        sim_clock_ticks(clock, params->vessel_fire_cooldown_time);
+    int i = vb->length;
+    vb->x[i] = pos.x;
+    vb->y[i] = pos.y;
+    vb->x_t1[i] = pos.x;
+    vb->y_t1[i] = pos.y;
+    vb->phi[i] = 0.0;
+    vb->phi_t1[i] = 0.0;
+    vb->remaining_lifes[i] = remaining_lifes;
+    vb->invincible_until[i] = clock->now + vb->inv_ticks;
+    vb->next_fire[i] = clock->now + vb->fire_cooldown_ticks;
+    vb->actions[i] = 0;
+    vb->length += 1;
+    return i;
+}
+
+void vessel_batch_add_bots(vessel_batch *vb, int remaining_lifes,
+                           const dyn_params *params) {
+    for (int b = 0; b < vb->num_bots; ++b) {
+        double u = (double)rand_r(&vb->seed) / ((double)RAND_MAX + 1.0);
+        double v = (double)rand_r(&vb->seed) / ((double)RAND_MAX + 1.0);
+        vec pos = vec_create(
+            params->pos_min.x + u * (params->pos_max.x - params->pos_min.x),
+            params->pos_min.y + v * (params->pos_max.y - params->pos_min.y));
+        if (vessel_batch_add(vb, pos, remaining_lifes, params) < 0) {
+            vb->num_bots = b;
+            return;
+        }
+    }
+}
+
+void vessel_batch_bot_actions(vessel_batch *vb, int first,
+                              const sim_clock *clock) {
+    for (int i = first; i < vb->length; ++i) {
+        // spread over the ticks, so that the bots do not all turn at once
+        if ((clock->now + (sim_tick)i) % (sim_tick)vb->think_ticks != 0) {
+            continue;
+        }
+        int r = rand_r(&vb->seed);
+        unsigned a = 0;
+        a |= (r & 1) ? ACTION_BIT(front_boost) : 0u;
+        a |= ((r >> 1) & 3) == 1 ? ACTION_BIT(turn_left) : 0u;
+        a |= ((r >> 1) & 3) == 2 ? ACTION_BIT(turn_right) : 0u;
+        a |= ((r >> 3) & 3) == 0 ? ACTION_BIT(fire_bullet) : 0u;
+        vb->actions[i] = a;
+    }
+}
+
+// the bullets are allocated one by one into the shared vector, thus fired
+// one vessel after the other, through vessel_fire_bullet
+static void vessel_batch_fire(vessel_batch *vb, vector *bullets,
+                              const dyn_params *params) {
+    const sim_clock *clock = &params->clock;
+    for (int i = 0; i < vb->length; ++i) {
+        if (!(vb->actions[i] & ACTION_BIT(fire_bullet)) ||
+            vb->remaining_lifes[i] <= 0 ||
+            !sim_clock_reached(clock, vb->next_fire[i])) {
+            continue;
+        }
+        vessel v = vessel_batch_get(vb, i, params);
+        bullet *b = vessel_fire_bullet(&v, params->bullet_max_distance,
+                                       params->bullet_vel, params->dt, clock);
+        vb->next_fire[i] = v.next_fire;
+        if (b != NULL) {
+            vector_push(bullets, b);
+            vb->fired += 1;
+        }
+    }
+}
+
+// +1.0 if the first action is in a, -1.0 for the second, 0.0 for both or
+// none, in integers not to branch
+static double vessel_batch_axis(unsigned a, actions plus, actions minus) {
+    return (double)((a >> plus) & 1u) - (double)((a >> minus) & 1u);
+}
+
+// the accelerations from the actions, then vessel_move_periodic, in the
+// same operations so that a vessel moves as a vessel of vessel.h. The limits
+// and the periodic wrap select between values all computed, which the
+// compiler turns into blends rather than branches when it may ignore the
+// floating point exceptions (-fno-trapping-math).
+static void vessel_batch_move(double *restrict x, double *restrict y,
+                              double *restrict x_t1, double *restrict y_t1,
+                              double *restrict phi, double *restrict phi_t1,
+                              const double *restrict sin_phi,
+                              const double *restrict cos_phi,
+                              const unsigned *restrict actions,
+                              const int *restrict remaining_lifes, int n,
+                              const dyn_params *params) {
+    double dt = params->dt;
+    double dt2 = dt * dt;
+    double inv_dt = 1.0 / dt;
+    double max_vel = params->vessel_max_vel;
+    double dt_max_vel = dt * max_vel;
+    double max_ang_vel = params->vessel_max_ang_vel;
+    double dt_max_ang_vel = dt * max_ang_vel;
+    double delta_lin = params->vessel_delta_lin_acc;
+    double delta_ang = params->vessel_delta_ang_acc;
+    double x0 = params->pos_min.x;
+    double x1 = params->pos_max.x;
+    double y0 = params->pos_min.y;
+    double y1 = params->pos_max.y;
+    for (int i = 0; i < n; ++i) {
+        unsigned a = actions[i] & (remaining_lifes[i] > 0 ? ~0u : 0u);
+        double lin =
+            delta_lin * vessel_batch_axis(a, front_boost, rear_boost);
+        double ang = delta_ang * vessel_batch_axis(a, turn_left, turn_right);
+
+        // tip rotated by phi, then made unit
+        double tx = tip.x * cos_phi[i] - tip.y * sin_phi[i];
+        double ty = tip.x * sin_phi[i] + tip.y * cos_phi[i];
+        double inv_norm = 1.0 / sqrt(tx * tx + ty * ty);
+        double ax = tx * inv_norm * lin;
+        double ay = ty * inv_norm * lin;
+
+        double px = x[i] * 2.0 - x_t1[i] + ax * dt2;
+        double py = y[i] * 2.0 - y_t1[i] + ay * dt2;
+        double vx = (px - x[i]) * inv_dt;
+        double vy = (py - y[i]) * inv_dt;
+        double speed = sqrt(vx * vx + vy * vy);
+        double inv_speed = 1.0 / speed;
+        double limited_x = x[i] + vx * inv_speed * dt_max_vel;
+        double limited_y = y[i] + vy * inv_speed * dt_max_vel;
+        px = speed > max_vel ? limited_x : px;
+        py = speed > max_vel ? limited_y : py;
+
+        double q = phi[i] * 2.0 - phi_t1[i] + dt2 * ang;
+        double w = (q - phi[i]) / dt;
+        double sign = w > 0.0 ? 1.0 : -1.0;
+        double limited_q = phi[i] + dt_max_ang_vel * sign;
+        q = fabs(w) > max_ang_vel ? limited_q : q;
+
+        // a vessel never crosses more than one edge in a tick
+        double sx = (px > x1 ? x0 - x1 : 0.0) + (px < x0 ? x1 - x0 : 0.0);
+        double sy = (py > y1 ? y0 - y1 : 0.0) + (py < y0 ? y1 - y0 : 0.0);
+        x_t1[i] = x[i] + sx;
+        y_t1[i] = y[i] + sy;
+        x[i] = px + sx;
+        y[i] = py + sy;
+        phi_t1[i] = phi[i];
+        phi[i] = q;
+    }
+}
+
+void vessel_batch_step(vessel_batch *vb, vector *bullets,
+                       const dyn_params *params) {
+    if (vb->length == 0) {
+        return;
+    }
+    vessel_batch_fire(vb, bullets, params);
+    // the only calls to the math library, not vectorized
+    for (int i = 0; i < vb->length; ++i) {
+        vb->sin_phi[i] = sin(vb->phi[i]);
+        vb->cos_phi[i] = cos(vb->phi[i]);
+    }
+    vessel_batch_move(vb->x, vb->y, vb->x_t1, vb->y_t1, vb->phi, vb->phi_t1,
+                      vb->sin_phi, vb->cos_phi, vb->actions,
+                      vb->remaining_lifes, vb->length, params);
+    vb->steps += 1;
+}
+
+// as vessel_blown
+static void vessel_batch_blow(vessel_batch *vb, int i,
+                              const sim_clock *clock) {
+    vb->remaining_lifes[i] -= 1;
+    vb->x_t1[i] = vb->x[i];
+    vb->y_t1[i] = vb->y[i];
+    vb->phi[i] = 0.0;
+    vb->phi_t1[i] = 0.0;
+    vb->invincible_until[i] = clock->now + vb->inv_ticks;
+    vb->next_fire[i] = clock->now + vb->fire_cooldown_ticks;
+    vb->blown += 1;
+}
+
+void vessel_batch_blown_by_asteroids(vessel_batch *vb, vector asteroids,
+                                     double max_radius, grid *g,
+                                     const sim_clock *clock) {
+    if (vb->length == 0) {
+        return;
+    }
+    asteroid_points_inside_grid(asteroids, vb->x, vb->y, vb->length,
+                                max_radius, g, vb->hits);
+    for (int i = 0; i < vb->length; ++i) {
+        if (vb->hits[i] && vb->remaining_lifes[i] > 0 &&
+            sim_clock_reached(clock, vb->invincible_until[i])) {
+            vessel_batch_blow(vb, i, clock);
+        }
+    }
+}
+
+bool vessel_batch_is_alive(const vessel_batch *vb, int i) {
+    return vb->remaining_lifes[i] > 0;
+}
+
+vec vessel_batch_pos(const vessel_batch *vb, int i) {
+    return vec_create(vb->x[i], vb->y[i]);
+}
+
+vessel vessel_batch_get(const vessel_batch *vb, int i,
+                        const dyn_params *params) {
+    vessel v;
+    v.pos = vec_create(vb->x[i], vb->y[i]);
+    v.pos_t1 = vec_create(vb->x_t1[i], vb->y_t1[i]);
+    v.phi = vb->phi[i];
+    v.phi_t1 = vb->phi_t1[i];
+    v.acc = vec_create_zero();
+    v.ang_acc = 0.0;
+    v.base_length = params->vessel_base_length;
+    v.mass = params->vessel_mass;
+    v.max_velocity = params->vessel_max_vel;
+    v.max_ang_velocity = params->vessel_max_ang_vel;
+    v.remaining_lifes = vb->remaining_lifes[i];
+    v.inv_ticks = vb->inv_ticks;
+    v.fire_cooldown_ticks = vb->fire_cooldown_ticks;
+    v.invincible_until = vb->invincible_until[i];
+    v.next_fire = vb->next_fire[i];
+    return v;
+}
+
+void vessel_batch_print(const vessel_batch *vb, FILE *out) {
+    if (vb->length < 2 || vb->steps == 0) {
+        return;
+    }
+    int alive = 0;
+    for (int i = 0; i < vb->length; ++i) {
+        alive += vb->remaining_lifes[i] > 0;
+    }
+    fprintf(out,
+            "vessels: %d (%d alive) over %lu ticks, %lu bullets fired, %lu "
+            "blown\n",
+            vb->length, alive, vb->steps, vb->fired, vb->blown);
+}
+
+void vessel_batch_free(vessel_batch *vb) {
+    free(vb->x);
+    free(vb->y);
+    free(vb->x_t1);
+    free(vb->y_t1);
+    free(vb->phi);
+    free(vb->phi_t1);
+    free(vb->sin_phi);
+    free(vb->cos_phi);
+    free(vb->hits);
+    free(vb->remaining_lifes);
+    free(vb->invincible_until);
+    free(vb->next_fire);
+    free(vb->actions);
+    *vb = (vessel_batch){0};
+}
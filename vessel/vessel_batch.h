@@ -0,0 +1,93 @@
+#ifndef _VESSEL_BATCH_H_
+#define _VESSEL_BATCH_H_
+
+#include "../c_vector/vector.h"
+#include "../geom/dyn_params.h"
+#include "../geom/grid.h"
+#include "../geom/sim_clock.h"
+#include "../geom/vec.h"
+#include "../graphics/actions.h"
+#include "vessel.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Every vessel of the game, the player's first, followed by the bots. They
+// share the parameters of the vessel of dyn_params and only differ by their
+// state, kept as arrays of doubles, one per coordinate, so that a tick
+// moves all of them with loops the compiler vectorizes. Each vessel acts
+// from its entry of actions, a bitmap of ACTION_BIT, set before the step by
+// the keyboard for the player and by vessel_batch_bot_actions for the bots,
+// or by any other driver. A vessel without lifes left is dead: it neither
+// moves, fires nor gets blown. The batch does not time itself, its callers
+// time the stages they run it in.
+typedef struct _vessel_batch {
+    int num_bots;    // vessels added by vessel_batch_add_bots
+    int think_ticks; // ticks a bot keeps the same actions
+    double *x;
+    double *y;
+    double *x_t1; // at the previous tick
+    double *y_t1;
+    double *phi;
+    double *phi_t1;
+    double *sin_phi; // scratch of the step
+    double *cos_phi;
+    bool *hits; // inside an asteroid, scratch of the collisions
+    int *remaining_lifes;
+    sim_tick *invincible_until; // first tick the vessel can be blown again
+    sim_tick *next_fire;        // first tick the vessel can fire again
+    unsigned *actions;
+    sim_tick inv_ticks; // of every vessel, set by the first one added
+    sim_tick fire_cooldown_ticks;
+    int length;
+    int capacity;
+    unsigned int seed;
+    unsigned long steps;
+    unsigned long fired;
+    unsigned long blown;
+} vessel_batch;
+
+vessel_batch vessel_batch_create_default();
+
+// handles --bots=<n> and --bot-think=<ticks>, returns false if arg is not
+// for the vessels
+bool vessel_batch_parse_arg(vessel_batch *vb, const char *arg);
+
+// adds a vessel at rest at pos, invincible and unable to fire for a while as
+// vessel_create, returns its index or -1 if there is no room for it
+int vessel_batch_add(vessel_batch *vb, vec pos, int remaining_lifes,
+                     const dyn_params *params);
+
+// adds num_bots vessels at random positions of the world
+void vessel_batch_add_bots(vessel_batch *vb, int remaining_lifes,
+                           const dyn_params *params);
+
+// draws new random actions for the bots whose turn it is, the vessels
+// before first being driven otherwise
+void vessel_batch_bot_actions(vessel_batch *vb, int first,
+                              const sim_clock *clock);
+
+// one tick of every vessel: fires the bullets asked for into bullets, then
+// moves the vessels from their actions in the periodic world of params
+void vessel_batch_step(vessel_batch *vb, vector *bullets,
+                       const dyn_params *params);
+
+// blows the vessels inside an asteroid, unless invincible, looking for the
+// asteroids around each vessel in g (rebuilt here) as the bullets do.
+// max_radius bounds the radius of the asteroids.
+void vessel_batch_blown_by_asteroids(vessel_batch *vb, vector asteroids,
+                                     double max_radius, grid *g,
+                                     const sim_clock *clock);
+
+bool vessel_batch_is_alive(const vessel_batch *vb, int i);
+
+vec vessel_batch_pos(const vessel_batch *vb, int i);
+
+// copy of the vessel i, for the functions of vessel.h
+vessel vessel_batch_get(const vessel_batch *vb, int i,
+                        const dyn_params *params);
+
+void vessel_batch_print(const vessel_batch *vb, FILE *out);
+
+void vessel_batch_free(vessel_batch *vb);
+
+#endif